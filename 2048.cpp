@@ -35,6 +35,11 @@
 #include "moporgic/util.h"
 #include "moporgic/math.h"
 #include "moporgic/shm.h"
+#include "moporgic/mmap.h"
+#include "moporgic/numa.h"
+#include "moporgic/pool.h"
+#include "moporgic/pack.h"
+#include "moporgic/ring.h"
 #include "board.h"
 
 namespace moporgic {
@@ -58,14 +63,15 @@ Recipes:
   -et MODE                 set default recipe mode for -e
 
 Parameters:
-  -a, --alpha ALPHA        set the learning rate, default: 0.1 (1.0 enables TC)
+  -a, --alpha ALPHA [OPT] set the learning rate, default: 0.1 (1.0 enables TC),
+                           or store weights as f16, bf16, i16, or i8
   -l, --lambda LAMBDA      set the TD-lambda, default: 0 (disabled)
   -N, --step STEP          set the n-step, default: 1 or 5 if TD-lambda is on
   -b, --block BLOCK        set the minimal learning block, default: disabled
   -@, --stage THRES        set the multi-stage thresholds, default: disabled
   -h, --shift THRES        set the tile-downgrading threshold, default is 65536
-  -d, --depth DEPTH [OPT]  enable the search with specified layers: 2p, 3p, ...
-  -c, --cache SIZE         enable the TT with specified size: 1G, 2G, ...
+  -d, --depth DEPTH [OPT]  enable the search with specified layers: 2p, 3p, ..., or time: 10ms, ...
+  -c, --cache SIZE [OPT]   enable the TT with specified size: 1G, 2G, ...
   -u, --unit UNIT          set the statistic display interval, default: 1000
   -w, --win TILE           set the winning threshold, default: 2048
   -%, --info               set whether to show the summary, default: auto
@@ -74,10 +80,13 @@ Input/Output:
   -i, --input [FILE]...    specify inputs, support .w and .c files
   -o, --output [FILE]...   specify outputs, support .w, .c, and .x files
   -io [FILE]...            alias for -i [FILE]... -o [FILE]...
+  -k, --checkpoint [UNIT|TIME]... save .w outputs periodically during training,
+                           e.g., every 10 units or 30m, default: 10
 
 Miscellaneous:
   -s, --seed [SEED]        set the seed for the pseudo-random number
   -p, --parallel [THREAD]  enable lock-free parallelism for all recipes
+  -m, --memory [OPT]...    set the memory allocation, e.g., huge[=2M|1G], thp
   -x, --options [OPT]...   specify other options as KEY[=VALUE]
   -#, --comment [TEXT]...  specify command line comments
   -v, --version            display program build revision and quit
@@ -91,7 +100,7 @@ typedef float numeric;
 
 class weight {
 public:
-	inline weight() : name(), length(0), raw(nullptr) {}
+	inline weight() : name(), length(0), raw(nullptr), unit(1) {}
 	inline weight(const weight& w) = default;
 	inline ~weight() {}
 
@@ -120,13 +129,34 @@ public:
 			accum = updvu = cinit;
 			return value = v;
 		}
-		inline constexpr numeric& operator +=(numeric delta) {
+		inline numeric& operator +=(numeric delta) {
+			if (atomic()) return update(delta);
 			value += delta * (std::abs(accum) / updvu);
 			accum += delta;
 			updvu += std::abs(delta);
 			return value;
 		}
 
+		/**
+		 * update the triple as a whole for concurrent training, where the entry is locked by the sign bit of updvu
+		 * (which is otherwise always positive), so that the layout is unchanged and the lock also works in SHM
+		 * note that readers (i.e., estimates) still read the value without locking, as in other schemes, and that
+		 * snapshots of SHM tables may capture locked entries, whose sign bits are therefore cleared on loading
+		 */
+		static inline bool& atomic() { static bool atomic = false; return atomic; }
+		inline numeric& update(numeric delta) {
+			constexpr u32 lock = 0x80000000u;
+			u32* bits = &raw_cast<u32>(updvu);
+			u32 last;
+			while ((last = __atomic_fetch_or(bits, lock, __ATOMIC_ACQUIRE)) & lock)
+				while (__atomic_load_n(bits, __ATOMIC_RELAXED) & lock) std::this_thread::yield();
+			numeric u = raw_cast<numeric>(last);
+			value += delta * (std::abs(accum) / u);
+			accum += delta;
+			__atomic_store_n(bits, raw_cast<u32>(numeric(u + std::abs(delta))), __ATOMIC_RELEASE);
+			return value;
+		}
+
 		template<size_t i> struct unit : std::array<numeric, 3> {
 			constexpr inline operator numeric&() { return operator [](i); }
 			constexpr inline operator const numeric&() const { return operator [](i); }
@@ -134,12 +164,80 @@ public:
 			declare_comparators_with(const numeric&, operator [](i), v, constexpr inline);
 		};
 	};
+	struct compact { // 16-bit storage in either f16 or bf16, widened on reads and narrowed with stochastic rounding on updates
+		u16 bits;
+		static constexpr u32 code = to_hash("compact");
+		inline constexpr compact() : bits(0) {}
+		inline constexpr compact(const compact& c) = default;
+		inline constexpr compact& operator =(const compact& c) = default;
+		inline operator numeric() const { return widen(bits); }
+		inline numeric operator =(numeric v) { return widen(bits = narrow(v)); }
+		inline numeric operator +=(numeric delta) { return widen(bits = narrow(widen(bits) + delta, dither())); }
+		declare_comparators_with(numeric, operator numeric(), v, inline);
+
+		static inline bool& bfloat() { static bool bf = false; return bf; }
+		static inline f32 widen(u16 h) {
+			if (bfloat()) return raw_cast<f32>(u32(h) << 16);
+#if defined(__F16C__)
+			return _cvtsh_ss(h);
+#else
+			return f32(f16::as(h));
+#endif
+		}
+		static inline u16 narrow(f32 v, u32 r = 0) {
+			// round to nearest if r is 0, otherwise add r to the truncated bits so that it rounds up with proportional probability
+			u32 x = raw_cast<u32>(v);
+			if (bfloat()) return (x + (r ? r & 0xffff : 0x7fff + ((x >> 16) & 1))) >> 16;
+			v = std::max(std::min(v, 65504.0f), -65504.0f); // saturate rather than overflow to inf
+			if (r) v = raw_cast<f32>((raw_cast<u32>(v) + (r & 0x1fff)) & ~0x1fffu); // exact in f16 unless it is subnormal
+#if defined(__F16C__)
+			return _cvtss_sh(v, _MM_FROUND_TO_NEAREST_INT);
+#else
+			u16 h = 0;
+			f16::as(h) = v;
+			return h;
+#endif
+		}
+		static inline u32 dither() {
+			static thread_local u64 x = 0x9e3779b97f4a7c15ull;
+			x ^= x << 13, x ^= x >> 7, x ^= x << 17;
+			return u32(x) | 1;
+		}
+	};
+	template<typename word> struct quantum { // integer storage in units of weight::scale, for evaluation
+		word bits;
+		static constexpr u32 code = to_hash(sizeof(word) == 1 ? "quantum8" : "quantum16");
+		static constexpr i32 bound = std::numeric_limits<word>::max();
+		inline constexpr quantum() : bits(0) {}
+		inline constexpr quantum(const quantum& q) = default;
+		inline constexpr quantum& operator =(const quantum& q) = default;
+		inline constexpr operator i32() const { return bits; }
+		inline constexpr i32 operator =(i32 v) { return bits = std::max(std::min(v, bound), -bound); }
+	};
+	typedef quantum<i16> quantum16;
+	typedef quantum<i8> quantum8;
 	typedef structure segment;
 	static u32& type() { static u32 code = segment::code; return code; }
 	static u32& type(u32 code) { return type() = code; }
+	static std::string& mapping() { static std::string path; return path; }
+	static std::string& mapping(const std::string& path) { return mapping() = path; }
+	static bool quantized() { return type() == quantum16::code || type() == quantum8::code; }
+	static std::string scheme() {
+		switch (type()) {
+		default:
+		case structure::code: return "f32";
+		case coherence::code: return "f32+tc";
+		case compact::code: return compact::bfloat() ? "bf16" : "f16";
+		case quantum16::code: return "i16";
+		case quantum8::code: return "i8";
+		}
+	}
 
 	inline sign_t sign() const { return name; }
 	inline size_t size() const { return length; }
+	inline bool sparse() const { return mmap::reserved(raw); }
+	inline numeric scale() const { return unit; }
+	inline numeric scale(numeric s) { return unit = s; }
 	constexpr inline segment& operator [](size_t i) { return pointer_cast<segment>(raw)[i]; }
 	template<typename type = segment> constexpr inline type& at(size_t i) { return pointer_cast<type>(raw)[i]; }
 	template<typename type = segment> constexpr inline type* data(size_t i = 0) const { return pointer_cast<type>(raw) + i; }
@@ -147,12 +245,42 @@ public:
 	inline operator bool() const { return raw; }
 	declare_comparators(const weight&, sign(), inline);
 
-	friend std::ostream& operator <<(std::ostream& out, const weight& w) {
-		u32 code = 4;
+	/**
+	 * widen the table into numeric values regardless of the scheme, or narrow the values back into the table, where
+	 * a quantized table keeps its scale unless rescale is set, which fits the scale to the largest magnitude
+	 */
+	std::vector<numeric> numerics() const {
+		std::vector<numeric> val(length);
+		switch (type()) {
+		default:
+		case structure::code: std::copy_n(data<structure>(), length, val.data()); break;
+		case coherence::code: std::copy_n(data<coherence::unit<0>>(), length, val.data()); break;
+		case compact::code: std::copy_n(data<compact>(), length, val.data()); break;
+		case quantum16::code: for (size_t i = 0; i < length; i++) val[i] = data<quantum16>()[i] * unit; break;
+		case quantum8::code: for (size_t i = 0; i < length; i++) val[i] = data<quantum8>()[i] * unit; break;
+		}
+		return val;
+	}
+	void numerics(const std::vector<numeric>& val, bool rescale = false) {
+		switch (type()) {
+		default:
+		case structure::code: std::copy_n(val.data(), length, data<structure>()); break;
+		case coherence::code: std::copy_n(val.data(), length, data<coherence::unit<0>>()); break;
+		case compact::code: std::copy_n(val.data(), length, data<compact>()); break;
+		case quantum16::code: quantize<quantum16>(val, rescale); break;
+		case quantum8::code: quantize<quantum8>(val, rescale); break;
+		}
+	}
+
+	friend std::ostream& operator <<(std::ostream& out, const weight& w) { return weight::write(out, w); }
+	static std::ostream& write(std::ostream& out, const weight& w, u32 code = 4) {
 		write_cast<u8>(out, code);
 		switch (code) {
 		default:
-		case 4: [&]() {
+		case 4:
+		case 5: // 5: same as 4 but value tables are packed, see weight::pack
+		case 6: // 6: same as 4 but value tables are quantized, see weight::scale
+		case 7: [&]() { // 7: same as 5 but tables are sparse, i.e., reserved rather than allocated on loading
 			try { // write sign as 32-bit integer if possible
 				size_t idx = 0;
 				u32 sign = std::stoul(w.sign(), &idx, 16);
@@ -163,7 +291,8 @@ public:
 			} catch (std::logic_error&) { // otherwise, write it as string
 				out.write(w.sign().append(8, ' ').c_str(), 8);
 			}
-			auto write_unit = [](std::ostream& out, auto data) {
+			auto write_unit = [code](std::ostream& out, auto data) {
+				if (code == 5 || code == 7) return weight::pack(out, data);
 				write_cast<numeric>(out, data.begin(), data.end());
 			};
 			switch (weight::type()) { // write value table
@@ -182,6 +311,26 @@ public:
 				write_unit(out, w.value<coherence::unit<1>>());
 				write_unit(out, w.value<coherence::unit<2>>());
 				break;
+			case compact::code: // widen compact tables, so that files are independent of the storage
+				write_cast<u16>(out, sizeof(numeric));
+				write_cast<u64>(out, w.size());
+				write_unit(out, w.value<compact>());
+				break;
+			case quantum16::code:
+			case quantum8::code:
+				if (code == 6) { // store words and the scale as is
+					u32 blkz = weight::type() == quantum16::code ? sizeof(quantum16) : sizeof(quantum8);
+					write_cast<u16>(out, blkz);
+					write_cast<u64>(out, w.size());
+					write_cast<f32>(out, w.scale());
+					out.write(w.data<char>(), w.size() * blkz);
+				} else { // widen quantized tables for other formats
+					std::vector<numeric> val = w.numerics();
+					write_cast<u16>(out, sizeof(numeric));
+					write_cast<u64>(out, w.size());
+					write_unit(out, clip<numeric>{ val.data(), val.data() + val.size() });
+				}
+				break;
 			}
 			// reserved for additional fields
 			write_cast<u16>(out, 0);
@@ -194,21 +343,43 @@ public:
 		read_cast<u8>(in, code);
 		switch (code) {
 		default:
-		case 4: [&]() {
+		case 4:
+		case 5:
+		case 6:
+		case 7: [&]() {
 			// read name (raw), block size, length, and value table
 			in.read(const_cast<char*>(w.name.assign(8, ' ').data()), 8);
-			auto read_unit = [blkz = read<u16>(in)](std::istream& in, auto data) {
+			u32 blkz = read<u16>(in);
+			auto read_unit = [blkz, code](std::istream& in, auto data) {
+				if (code == 5 || code == 7) return weight::unpack(in, data);
 				switch (blkz) { // binaries may typedef different numeric
 				case 2: read_cast<f16>(in, data.begin(), data.end()); break;
 				case 4: read_cast<f32>(in, data.begin(), data.end()); break;
 				case 8: read_cast<f64>(in, data.begin(), data.end()); break;
 				}
 			};
-			w.raw = weight::alloc(w.length = read<u64>(in));
-			switch (weight::type()) {
+			w.length = read<u64>(in);
+			w.raw = blkz == sizeof(numeric) && code == 4 ? weight::map(in, w.length) : nullptr;
+			bool mapped = w.raw;
+			if (!mapped) w.raw = code == 7 && !mmap::huge<segment>() ? weight::reserve(w.length) : weight::alloc(w.length);
+			else in.seekg(w.length * blkz, std::ios::cur);
+			if (code == 6) { // quantized table
+				numeric scale = read<f32>(in);
+				if (blkz == (weight::type() == quantum16::code ? 2u : weight::type() == quantum8::code ? 1u : 0u)) {
+					in.read(w.data<char>(), w.length * blkz);
+					w.unit = scale;
+				} else { // dequantize, then narrow into the current scheme
+					std::vector<char> buf(w.length * blkz);
+					in.read(buf.data(), buf.size());
+					std::vector<numeric> val(w.length);
+					for (size_t i = 0; i < w.length; i++)
+						val[i] = (blkz == 1 ? raw_cast<i8>(buf[i]) : raw_cast<i16>(buf[i * 2])) * scale;
+					w.numerics(val, true);
+				}
+			} else switch (weight::type()) {
 			default:
 			case structure::code:
-				read_unit(in, w.value<structure>());
+				if (!mapped) read_unit(in, w.value<structure>());
 				break;
 			case coherence::code:
 				read_unit(in, w.value<coherence::unit<0>>());
@@ -217,10 +388,19 @@ public:
 				in.ignore(8);
 				read_unit(in, w.value<coherence::unit<1>>());
 				read_unit(in, w.value<coherence::unit<2>>());
-				// fix legacy coherence::cinit == 0
+				// fix legacy coherence::cinit == 0, and clear locks captured by a live snapshot (see coherence::update)
 				for (coherence& c : w.value<coherence>())
-					if (c.updvu == 0) c = numeric(c);
+					if ((c.updvu = std::abs(c.updvu)) == 0) c = numeric(c);
+				break;
+			case compact::code:
+				read_unit(in, w.value<compact>());
 				break;
+			case quantum16::code:
+			case quantum8::code: [&]() { // quantize with a scale that fits the table
+				std::vector<numeric> val(w.length);
+				read_unit(in, clip<numeric>{ val.data(), val.data() + val.size() });
+				w.numerics(val, true);
+			}(); break;
 			}
 			// skip unrecognized fields
 			for (u32 blkz; (blkz = read<u16>(in)); in.ignore(blkz * read<u64>(in)));
@@ -240,14 +420,26 @@ public:
 	}
 
 	static list<weight> save(std::ostream& out, std::string opt = {}) {
-		u32 code = 0;
+		u32 code = opt.find("mmap") != std::string::npos ? 1 : 0;
 		write_cast<u8>(out, code);
 		list<weight> res;
 		switch (code) {
 		case 0: [&]() {
 			std::vector<u32> idxes = idx_select(opt);
 			write_cast<u32>(out, idxes.size());
-			for (u32 idx : idxes) out << wghts()[idx], res.push_back(wghts()[idx]);
+			u32 form = weight::quantized() ? 6 : opt.find("pack") != std::string::npos ? 5 : 4;
+			for (u32 idx : idxes) write(out, wghts()[idx], form != 6 && wghts()[idx].sparse() ? 7 : form), res.push_back(wghts()[idx]);
+		}(); break;
+		case 1: [&]() { // page-aligned value tables, which can be mapped directly by weight::map
+			std::vector<u32> idxes = idx_select(opt);
+			write_cast<u32>(out, idxes.size());
+			for (u32 idx : idxes) {
+				size_t head = size_t(out.tellp()) + 2 + 19; // padding length, code, sign, block size, and length
+				u16 pad = (align - head % align) % align;
+				write_cast<u16>(out, pad);
+				out.write(std::string(pad, '\0').data(), pad);
+				out << wghts()[idx], res.push_back(wghts()[idx]);
+			}
 		}(); break;
 		}
 		return res;
@@ -257,10 +449,11 @@ public:
 		read_cast<u8>(in, code);
 		list<weight> res;
 		switch (code) {
-		case 0: [&]() {
+		case 0:
+		case 1: [&]() {
 			weight::container buf;
 			for (u32 num = read<u32>(in); num; num--)
-				in >> buf.emplace_back();
+				(code == 1 ? in.ignore(read<u16>(in)) : in) >> buf.emplace_back();
 			for (u32 idx : idx_select(opt + format("[0:%u]", u32(buf.size()))))
 				wghts().push_back(buf[idx]), res.push_back(buf[idx]);
 			for (weight w : buf)
@@ -293,7 +486,7 @@ public:
 		constexpr container() noexcept : list<weight>() {}
 		container(const clip<weight>& w) : list<weight>(w) {}
 	public:
-		weight& make(sign_t sign, size_t size) { return list<weight>::emplace_back(weight(sign, size)); }
+		weight& make(sign_t sign, size_t size, bool sparse = false) { return list<weight>::emplace_back(weight(sign, size, sparse)); }
 		weight erase(sign_t sign) { auto it = find(sign); auto w = *it; free(it->data()); list<weight>::erase(it); return w; }
 		weight* find(sign_t sign) const { return std::find_if(begin(), end(), [=](const weight& w) { return w.sign() == sign; }); }
 		weight& at(sign_t sign) const { auto it = find(sign); if (it != end()) return *it; throw std::out_of_range("weight::at"); }
@@ -302,25 +495,125 @@ public:
 	};
 
 	static inline weight::container& wghts() { static container w; return w; }
-	static inline weight& make(sign_t sign, size_t size, container& src = wghts()) { return src.make(sign, size); }
+	static inline u32& helpers() { static u32 n = std::max(std::thread::hardware_concurrency(), 1u) - 1; return n; } // threads to help (un)packing
+	static inline weight& make(sign_t sign, size_t size, container& src = wghts(), bool sparse = false) { return src.make(sign, size, sparse); }
 	static inline size_t erase(sign_t sign, container& src = wghts()) { return src.erase(sign); }
 	inline weight(sign_t sign, const container& src = wghts()) : weight(src(sign)) {}
 
 private:
-	inline weight(sign_t sign, size_t size) : name(sign), length(size), raw(alloc(size)) {}
+	inline weight(sign_t sign, size_t size, bool sparse = false) : name(sign), length(size), raw(sparse ? reserve(size) : alloc(size)), unit(1) {}
 
 	static inline structure* alloc(size_t size) {
 		switch (weight::type()) {
 		default:
-		case structure::code: return shm::enable<segment>() ? shm::alloc<structure>(size) : new structure[size]();
-		case coherence::code: return shm::enable<segment>() ? shm::alloc<coherence>(size) : new coherence[size]();
+		case structure::code: return alloc<structure>(size);
+		case coherence::code: return alloc<coherence>(size);
+		case compact::code: return pointer_cast<structure>(alloc<compact>(size));
+		case quantum16::code: return pointer_cast<structure>(alloc<quantum16>(size));
+		case quantum8::code: return pointer_cast<structure>(alloc<quantum8>(size));
+		}
+	}
+	template<typename type> static inline type* alloc(size_t size) {
+		if (shm::enable<segment>()) return shm::alloc<type>(size, mmap::huge<segment>());
+		if (mmap::huge<segment>()) return mmap::alloc<type>(size, mmap::huge<segment>());
+		return new type[size]();
+	}
+	/**
+	 * allocate a sparse table, whose pages are committed on first write, see mmap::reserve
+	 * this relies on zero-initialized memory, so tables of coherence (nonzero init) or in SHM are always dense
+	 */
+	static inline structure* reserve(size_t size) {
+		if (!mmap::support() || shm::enable<segment>()) return alloc(size);
+		switch (weight::type()) {
+		default:
+		case structure::code: return mmap::reserve<structure>(size);
+		case coherence::code: return alloc(size);
+		case compact::code: return pointer_cast<structure>(mmap::reserve<compact>(size));
+		case quantum16::code: return pointer_cast<structure>(mmap::reserve<quantum16>(size));
+		case quantum8::code: return pointer_cast<structure>(mmap::reserve<quantum8>(size));
+		}
+	}
+	static inline void free(structure* v) {
+		if (mmap::mapped(v)) return mmap::unmap(v);
+		shm::enable<segment>() ? shm::free<structure>(v) : delete[] v;
+	}
+
+	template<typename type> void quantize(const std::vector<numeric>& val, bool rescale) {
+		if (rescale) {
+			numeric peak = 0;
+			for (numeric v : val) peak = std::max(peak, std::abs(v));
+			unit = peak ? peak / type::bound : 1;
 		}
+		for (size_t i = 0; i < length; i++) at<type>(i) = i32(std::lround(val[i] / unit));
+	}
+
+	static constexpr size_t align = 4096;
+	static inline structure* map(std::istream& in, size_t size) {
+		// map the value table from the file being loaded (copy-on-write), only if
+		// (1) the table is page-aligned; (2) the in-memory layout matches; (3) no SHM is required
+		size_t offset = in.tellg();
+		if (mapping().empty() || offset % mmap::page() || weight::type() != structure::code || shm::enable<segment>()) return nullptr;
+		try {
+			return mmap::map<structure>(mapping(), offset, size, true);
+		} catch (std::exception&) {
+			return nullptr;
+		}
+	}
+
+	/**
+	 * the packed layout of a value table: u32 chunk length, u64 packed size of each chunk, then the packed chunks
+	 * chunks are independent, so they are (de)coded in parallel, and decoded straight into the table if possible
+	 */
+	static constexpr size_t chunk = 1 << 20;
+	template<typename clip> static void pack(std::ostream& out, clip data) {
+		size_t num = (data.size() + chunk - 1) / chunk;
+		std::vector<std::string> buf(num);
+		bool sparse = mmap::reserved(data.data());
+		moporgic::pool(std::min(size_t(helpers()) + 1, num) - 1).run(num, [&](size_t i) {
+			auto sub = data.subc(i * chunk, chunk);
+			if (sparse && !mmap::populated(sub.data(), sub.size() * sizeof(*sub.data()))) { // never written
+				buf[i] = moporgic::pack::zeros(sub.size());
+			} else if (sizeof(*sub.data()) == sizeof(u32)) {
+				buf[i] = moporgic::pack::encode(pointer_cast<u32>(sub.data()), sub.size());
+			} else {
+				std::vector<u32> raw(sub.size());
+				for (size_t k = 0; k < sub.size(); k++) raw[k] = raw_cast<u32>(f32(sub[k]));
+				buf[i] = moporgic::pack::encode(raw.data(), raw.size());
+			}
+		});
+		write_cast<u32>(out, chunk);
+		for (std::string& b : buf) write_cast<u64>(out, b.size());
+		for (std::string& b : buf) out.write(b.data(), b.size());
+	}
+	template<typename clip> static void unpack(std::istream& in, clip data) {
+		size_t size = read<u32>(in);
+		if (!size || !in) throw std::runtime_error("corrupted value table");
+		size_t num = (data.size() + size - 1) / size;
+		std::vector<size_t> offset(num + 1, 0);
+		for (size_t i = 0; i < num; i++) offset[i + 1] = offset[i] + read<u64>(in);
+		std::string buf(offset[num], '\0');
+		in.read(&buf[0], buf.size());
+		std::atomic<bool> fail(false);
+		bool zeroed = mmap::reserved(data.data());
+		moporgic::pool(std::min(size_t(helpers()) + 1, num) - 1).run(num, [&](size_t i) {
+			auto sub = data.subc(i * size, size);
+			const char* src = buf.data() + offset[i];
+			size_t len = offset[i + 1] - offset[i];
+			if (sizeof(*sub.data()) == sizeof(u32)) {
+				if (!moporgic::pack::decode(src, len, pointer_cast<u32>(sub.data()), sub.size(), zeroed)) fail = true;
+			} else {
+				std::vector<u32> raw(sub.size());
+				if (!moporgic::pack::decode(src, len, raw.data(), raw.size())) fail = true;
+				for (size_t k = 0; k < sub.size(); k++) if (raw[k] || !zeroed) sub[k] = raw_cast<f32>(raw[k]);
+			}
+		});
+		if (fail || !in) throw std::runtime_error("corrupted value table");
 	}
-	static inline void free(structure* v) { shm::enable<segment>() ? shm::free<structure>(v) : delete[] v; }
 
 	sign_t name;
 	size_t length;
 	structure* raw;
+	numeric unit;
 };
 
 class indexer {
@@ -380,6 +673,7 @@ public:
 
 	inline indexer index() const { return map; }
 	inline weight  value() const { return raw; }
+	inline numeric scale() const { return raw.scale(); }
 	inline operator bool() const { return map && raw; }
 	declare_comparators(const feature&, sign(), inline);
 
@@ -416,17 +710,43 @@ private:
 
 class cache {
 public:
+	/**
+	 * per-thread counters of TT accesses by depth, i.e., probes and hits of lookups,
+	 * stores that update the same board, and stores that evict another board
+	 */
+	struct stats {
+		std::array<u64, 16> probe, hit, store, update, evict;
+		stats& operator +=(const stats& st) {
+			for (u32 i = 0; i < 16; i++) {
+				probe[i] += st.probe[i];
+				hit[i] += st.hit[i];
+				store[i] += st.store[i];
+				update[i] += st.update[i];
+				evict[i] += st.evict[i];
+			}
+			return *this;
+		}
+		static inline stats& local() { static thread_local stats st = {}; return st; }
+	};
+
 	class block {
 	public:
 		class access {
 		public:
-			constexpr access(u64 sign, u32 hold, block& blk) : sign(sign), info(0), blk(blk) {
-				block shot = blk;
-				bool safe = (shot.sign() == sign) & (shot.hold() >= hold);
+			inline access(u64 sign, u32 hold, block* bkt, u32 way) : sign(sign), info(0), blk(nullptr), bkt(bkt), way(way), type(0) {
+				// probe the bucket for the board, the block to be replaced is selected later when storing
+				u32 i = 0;
+				while (i < way && bkt[i].sign() != sign) i++;
+				block shot = i < way ? bkt[i] : block();
+				if (shot.sign() == sign) blk = bkt + i;
+				if (blk && (shot.hold() >= hold)) type = shot.bound();
+				bool safe = blk && (shot.hold() >= hold) && !type;
 				u32 hits = std::min(shot.hits() + 1, 65535);
 				raw_cast<f32, 0>(info) = shot.esti();
-				raw_cast<u16, 2>(info) = hold;
+				raw_cast<u8, 4>(info) = std::min(hold, 63u); // 6-bit field, see block::hold
 				raw_cast<u16, 3>(info) = safe ? hits : 0;
+				stats::local().probe[std::min(hold, 15u)] += 1;
+				stats::local().hit[std::min(hold, 15u)] += safe ? 1 : 0;
 			}
 			constexpr access(access&& acc) = default;
 			constexpr access(const access&) = delete;
@@ -434,41 +754,83 @@ public:
 
 			constexpr operator bool() const { return raw_cast<u16, 3>(info); }
 			constexpr numeric fetch() const { return raw_cast<f32, 0>(info); }
-			constexpr numeric store(numeric esti) {
+			constexpr u32 bound() const { return type; } // the bound type of a deep enough entry, see block::bound
+			inline numeric store(numeric esti, u32 bound = 0) {
+				u32 hold = raw_cast<u8, 4>(info) & 63, ply = std::min(hold, 15u); // counters are capped at 15
+				raw_cast<u8, 4>(info) = hold | (bound << 6);
+				stats::local().store[ply] += 1;
+				if (blk) {
+					stats::local().update[ply] += 1;
+				} else {
+					blk = way > 1 ? victim(bkt, way) : bkt;
+					stats::local().evict[ply] += blk->info ? 1 : 0;
+				}
 				raw_cast<f32, 0>(info) = esti;
+				raw_cast<u8, 5>(info) = epoch();
 				raw_cast<u16, 3>(info) = std::min(raw_cast<u16, 3>(info) + 1, 65535);
-				blk = block(sign, info);
+				*blk = block(sign, info);
 				return esti;
 			}
 		private:
+			static inline block* victim(block* bkt, u32 way) {
+				block* blk = bkt;
+				u32 worst = -1u, epoch = cache::epoch();
+				for (u32 i = 0; i < way && worst; i++) {
+					u32 worth = bkt[i].worth(epoch);
+					if (worth < worst) blk = bkt + i, worst = worth;
+				}
+				return blk;
+			}
+
 			u64 sign;
-			u64 info; // f32 esti; u16 hold; u16 hits;
-			block& blk;
+			u64 info; // f32 esti; u6 hold; u2 bound; u8 age; u16 hits;
+			block* blk;
+			block* bkt;
+			u32 way;
+			u32 type;
 		};
 
 		constexpr block(const block& e) = default;
 		constexpr block(u64 sign = 0, u64 info = 0) : hash(sign ^ info), info(info) {}
-		constexpr access operator()(u64 x, u32 n) { return access(x, n, *this); }
 		constexpr u64 sign() const { return hash ^ info; }
 		constexpr f32 esti() const { return raw_cast<f32, 0>(info); }
-		constexpr u16 hold() const { return raw_cast<u16, 2>(info); }
+		constexpr u8  hold() const { return raw_cast<u8, 4>(info) & 63; }
+		constexpr u8  bound() const { return raw_cast<u8, 4>(info) >> 6; } // 0: exact, 1: upper bound, 2: lower bound
+		constexpr u8  age()  const { return raw_cast<u8, 5>(info); }
 		constexpr u16 hits() const { return raw_cast<u16, 3>(info); }
 
+		/**
+		 * the value of keeping this block: deeper results are preferred, frequently hit ones come next,
+		 * and results from earlier searches (4 roots per move) gradually lose their value
+		 */
+		constexpr u32 worth(u8 epoch) const {
+			if (!info) return 0;
+			u32 elapsed = u8(epoch - age()) >> 2;
+			return std::max(i32((hold() << 4) + std::min(math::lg(u16(hits() | 1)), 7u) - elapsed), 0) + 1;
+		}
+
 	private:
 		u64 hash;
-		u64 info; // f32 esti; u16 hold; u16 hits;
+		u64 info; // f32 esti; u6 hold; u2 bound; u8 age; u16 hits;
 	};
 
-	constexpr cache() : cached(&initial), length(1), mask(0), nmap{} {}
+	/**
+	 * the generation of searches of this thread, which should be advanced once per search root
+	 */
+	static inline u8& epoch() { static thread_local u8 epoch = 0; return epoch; }
+	static inline void aging() { epoch()++; }
+
+	constexpr cache() : cached(&initial), length(1), mask(0), way(1), nmap{} {}
 	constexpr inline size_t size() const { return length; }
+	constexpr inline u32 ways() const { return way; }
 	constexpr inline block& operator[] (size_t i) { return cached[i]; }
 	constexpr inline const block& operator[] (size_t i) const { return cached[i]; }
-	constexpr inline block::access operator() (const board& b, u32 n) {
+	inline block::access operator() (const board& b, u32 n) {
 		u64 x = ({ board x(b); x.isomin64(); x; });
-		return (*this)[indexof(x, n)](x, n);
+		return block::access(x, n, cached + indexof(x, n), way);
 	}
-	constexpr inline size_t indexof(u64 x, u32 n) const {
-		return (math::fmix64(x) ^ nmap[n >> 1]) & mask;
+	constexpr inline size_t indexof(u64 x, u32 n) const { // the first block of the bucket
+		return (math::fmix64(x) ^ nmap[n >> 1]) & mask & -size_t(way);
 	}
 
     friend std::ostream& operator <<(std::ostream& out, const cache& c) {
@@ -488,6 +850,10 @@ public:
 			write_cast<u16>(out, sizeof(u64));
 			write_cast<u64>(out, c.nmap.size());
 			write_cast<u64>(out, c.nmap.begin(), c.nmap.end());
+			// write ways of buckets
+			write_cast<u16>(out, sizeof(u32));
+			write_cast<u64>(out, 1);
+			write_cast<u32>(out, c.way);
 			// reserved for fields
 			write_cast<u16>(out, 0);
 		}(); break;
@@ -502,29 +868,44 @@ public:
 		case 4: [&]() {
 			// ignore unused header
 			in.ignore(read<u16>(in) * read<u64>(in));
-			// read blocks (block size is ignored)
-			c.init(read<u64>(in.ignore(2)));
-			read<block>(in, c.cached, c.cached + c.size());
+			// read blocks (block size is ignored), or map them from the file if possible
+			size_t len = read<u64>(in.ignore(2));
+			if (!c.map(in, len)) {
+				c.init(len, false, c.way);
+				read<block>(in, c.cached, c.cached + c.size());
+			}
 			// read depth-map (nmap)
 			u32 blkz = read<u16>(in);
 			size_t nmnum = read<u64>(in);
 			read_cast<u64>(in, c.nmap.begin(), c.nmap.begin() + std::min(c.nmap.size(), nmnum));
 			if (nmnum > c.nmap.size()) in.ignore(sizeof(u64) * (nmnum - c.nmap.size()));
+			// read ways of buckets if available
+			if ((blkz = read<u16>(in)) == sizeof(u32) && read<u64>(in) == 1) {
+				c.way = std::min(size_t(read<u32>(in)), c.size());
+				blkz = read<u16>(in);
+			}
 			// ignore unrecognized fields
-			while ((blkz = read<u16>(in)) != 0) in.ignore(blkz * read<u64>(in));
+			for (; blkz != 0; blkz = read<u16>(in)) in.ignore(blkz * read<u64>(in));
 		}(); break;
 		}
 		return in;
 	}
 
 	static list<cache> save(std::ostream& out, std::string opt = {}) {
-		u32 code = 0;
+		u32 code = opt.find("mmap") != std::string::npos ? 1 : 0;
 		write_cast<byte>(out, code);
 		list<cache> res;
 		switch (code) {
 		case 0:
 			out << instance(), res.push_back(instance());
 			break;
+		case 1: [&]() { // page-aligned blocks, which can be mapped directly by cache::map
+			size_t head = size_t(out.tellp()) + 2 + 21; // padding length, code, header, block size, and length
+			u16 pad = (align - head % align) % align;
+			write_cast<u16>(out, pad);
+			out.write(std::string(pad, '\0').data(), pad);
+			out << instance(), res.push_back(instance());
+		}(); break;
 		}
 		return res;
 	}
@@ -534,24 +915,43 @@ public:
 		list<cache> res;
 		switch (code) {
 		case 0:
+		case 1:
+			if (code == 1) in.ignore(read<u16>(in));
 			in >> instance(), res.push_back(instance());
 			break;
 		}
 		return res;
 	}
 
+	/**
+	 * the file to be mapped when loading, and whether the mapping is shared (i.e., read-write) rather than private
+	 */
+	static std::string& mapping() { static std::string path; return path; }
+	static std::string& mapping(const std::string& path, bool shared = false) { return mapping() = (cache::shared() = shared, path); }
+	static bool& shared() { static bool shared = false; return shared; }
+
 	static inline block::access find(const board& b, u32 n) { return instance()(b, n); }
-	static inline cache& make(size_t len, bool peek = false) { return instance().init(std::max(len, size_t(1)), peek); }
+	static inline cache& make(size_t len, bool peek = false, u32 way = 1) { return instance().init(std::max(len, size_t(1)), peek, way); }
 	static inline cache& refresh() { return instance().reset(); }
 	static inline cache& instance() { static cache tp; return tp; }
 
 private:
-	static inline block* alloc(size_t len) { return shm::enable<block>() ? shm::alloc<block>(len) : new block[len](); }
-	static inline void free(block* alloc) { shm::enable<block>() ? shm::free<block>(alloc) : delete[] alloc; }
+	static inline block* alloc(size_t len) {
+		if (shm::enable<block>()) return shm::alloc<block>(len, mmap::huge<block>());
+		if (mmap::huge<block>()) return mmap::alloc<block>(len, mmap::huge<block>());
+		void* mem = ::aligned_alloc(64, (len * sizeof(block) + 63) & -size_t(64)); // align buckets to cache lines
+		if (!mem) throw std::bad_alloc();
+		return new (mem) block[len]();
+	}
+	static inline void free(block* alloc) {
+		if (mmap::mapped(alloc)) return mmap::unmap(alloc);
+		shm::enable<block>() ? shm::free<block>(alloc) : std::free(alloc);
+	}
 
-	cache& init(size_t len, bool peek = false) {
+	cache& init(size_t len, bool peek = false, u32 way = 1) {
 		length = (1ull << (math::lg64(len)));
 		mask = length - 1;
+		this->way = std::min(u32(1) << math::lg(std::max(way, 1u)), u32(length));
 		if (cached != &initial) free(cached);
 		cached = length > 1 ? alloc(length) : &initial;
 		for (size_t i = 0; i < nmap.size(); i++)
@@ -563,11 +963,34 @@ private:
 		return *this;
 	}
 
+	static constexpr size_t align = 4096;
+	bool map(std::istream& in, size_t len) {
+		// map the blocks from the file being loaded (copy-on-write unless shared), only if
+		// (1) the blocks are page-aligned; (2) the length is valid; (3) no SHM is required, or the mapping is shared
+		size_t offset = in.tellg();
+		if (mapping().empty() || offset % mmap::page() || len < 2 || (len & (len - 1))) return false;
+		if (shm::enable<block>() && !shared()) return false;
+		try {
+			block* blk = mmap::map<block>(mapping(), offset, len, true, shared());
+			u32 ways = way;
+			init(1, false, ways);
+			cached = blk;
+			length = len;
+			mask = length - 1;
+			way = std::min(size_t(ways), length);
+			in.seekg(len * sizeof(block), std::ios::cur);
+			return true;
+		} catch (std::exception&) {
+			return false;
+		}
+	}
+
 private:
 	block* cached;
 	block initial;
 	size_t length;
 	size_t mask;
+	u32 way;
 	std::array<size_t, 16> nmap;
 };
 
@@ -586,8 +1009,83 @@ inline constexpr u32 order() {
 	return 2; // strictly ordered
 }
 
+/**
+ * generic pattern indexer, i.e., extract the tiles with PEXT then reorder the nibbles with PSHUFB
+ * tiles are extracted in ascending order, thus monotone patterns need no reordering
+ */
+struct pextpt {
+	u64 mask = 0; // tiles to be extracted
+	u64 perm[2] = { -1ull, -1ull }; // shuffle control of nibbles (as bytes), 0xff for zero
+	bool mono = true; // whether the tiles are strictly ascending
+
+	constexpr pextpt() {}
+	template<typename iter> constexpr pextpt(iter first, iter last) {
+		for (iter it = first; it != last; it++) mask |= 0xfull << (*it << 2);
+		u32 n = 0, x = 0;
+		for (iter it = first; it != last; x = *(it++), n++) {
+			u64 rank = math::popcnt64(mask & ((0xfull << (*it << 2)) - 1)) >> 2;
+			perm[n >> 3] = (perm[n >> 3] & ~(0xffull << ((n & 7) << 3))) | (rank << ((n & 7) << 3));
+			mono &= (n == 0) | (*it > x);
+		}
+	}
+	constexpr pextpt(std::initializer_list<u32> p) : pextpt(p.begin(), p.end()) {}
+	pextpt(const std::vector<u32>& p) : pextpt(p.begin(), p.end()) {}
+
+	constexpr inline u64 extract(const board& b) const { return math::pext64(b, mask); }
+#if defined(__BMI2__) && defined(__SSSE3__)
+	template<bool wide = true>
+	inline u64 shuffle(const board& b) const {
+		constexpr u64 nib = 0x0f0f0f0f0f0f0f0full;
+		u64 x = math::pext64(b, mask);
+		__m128i v = _mm_set_epi64x(wide ? math::pdep64(x >> 32, nib) : 0, math::pdep64(x, nib));
+		v = _mm_shuffle_epi8(v, _mm_set_epi64x(perm[1], perm[0]));
+		u64 lo = math::pext64(_mm_cvtsi128_si64(v), nib);
+		return wide ? lo | (math::pext64(_mm_cvtsi128_si64(_mm_unpackhi_epi64(v, v)), nib) << 32) : lo;
+	}
+#else
+	template<bool wide = true>
+	inline u64 shuffle(const board& b) const {
+		u64 x = math::pext64(b, mask), index = 0;
+		for (u32 n = 0; n < 16 && u8(perm[n >> 3] >> ((n & 7) << 3)) != 0xff; n++)
+			index |= ((x >> (u8(perm[n >> 3] >> ((n & 7) << 3)) << 2)) & 0xf) << (n << 2);
+		return index;
+	}
+#endif
+
+	/**
+	 * runtime patterns are kept in slots, each slot has its own mapper so that no indirect call is needed
+	 */
+	static inline list<pextpt>& slots() { static list<pextpt> s; return s; }
+	static constexpr u32 limit = 256;
+
+	template<u32 idx> static u64 extract_slot(const board& b) { return slots()[idx].extract(b); }
+	template<u32 idx> static u64 shuffle_slot(const board& b) { return slots()[idx].shuffle(b); }
+
+	template<u32... idx>
+	static indexer::mapper mapper(u32 i, bool mono, std::integer_sequence<u32, idx...>) {
+		constexpr indexer::mapper ext[] = { extract_slot<idx>... }, shf[] = { shuffle_slot<idx>... };
+		return mono ? ext[i] : shf[i];
+	}
+
+	/**
+	 * make a mapper for pattern p, or return nullptr if it is not supported or slots are exhausted
+	 */
+	static indexer::mapper make(const std::vector<u32>& p) {
+		if (p.empty() || p.size() > 16 || slots().size() >= limit) return nullptr;
+		if (std::any_of(p.begin(), p.end(), [](u32 x) { return x >= 16; })) return nullptr;
+		slots().emplace_back(p);
+		return mapper(slots().size() - 1, slots().back().mono, std::make_integer_sequence<u32, limit>());
+	}
+};
+
 template<u32... patt>
 inline constexpr typename std::enable_if<order<patt...>() == 0, u64>::type indexpt(const board& b) {
+#if defined(__BMI2__) && defined(__SSSE3__) && !defined(PREFER_LEGACY_INDEXPT_ORDER) && defined(__cpp_lib_is_constant_evaluated)
+	if (!std::is_constant_evaluated()) {
+		constexpr pextpt x = { patt... };
+		return x.template shuffle<false>(b);
+	}
+#endif
 	u32 index = 0, n = 0;
 	for (u32 p : { patt... }) index += b.at(p) << (n++ << 2);
 	return index;
@@ -747,9 +1245,11 @@ struct make {
 		template<u32 i> static typename std::enable_if<(i == 8), void>::type isomorphic(bool iso) {}
 
 		static constexpr board isoindex(u32 i) {
-			board x = 0xfedcba9876543210ull;
-			x.isom((i & 4) + (8 - i) % 4);
-			return x;
+			// equivalent to x.isom((i & 4) + (8 - i) % 4)
+			board x[8];
+			constexpr u32 isom[8] = { 0, 6, 4, 2, 1, 3, 5, 7 };
+			board(0xfedcba9876543210ull).isochain64(x);
+			return x[isom[i]];
 		}
 		static std::string vtos(const std::initializer_list<u32>& v) {
 			std::string name;
@@ -1011,7 +1511,8 @@ void init_cache(utils::options::option opt) {
 		case 'G': size *= ((1ULL << 30) / sizeof(cache::block)); break;
 		}
 	bool peek = opt("peek") & !opt("nopeek");
-	cache::make(size, peek);
+	u32 way = opt["way"].value(4);
+	cache::make(size, peek, way);
 }
 
 void config_random(utils::options::option opt) {
@@ -1022,42 +1523,140 @@ void config_memory(utils::options::option opt) {
 	shm::enable(shm::support() && !opt("noshm") && (opt("shm") || opt.value(1) > 1));
 	shm::enable<weight::segment>(shm::enable() && !opt("noshm:weight") && (opt("shm") || opt("shm:weight") || opt("optimize")));
 	shm::enable<cache::block>(shm::enable() && !opt("noshm:cache") && (opt("shm") || opt("shm:cache") || opt("evaluate")));
+	auto hugepage = [&](const std::string& use) -> size_t {
+		// huge[:use][=2M|1G] for hugetlb pages (fall back to THP), thp[:use] for THP only
+		for (std::string scope : {":" + use, std::string()}) {
+			if (opt("nohuge" + scope)) return 0;
+			if (opt("huge" + scope)) {
+				std::string res = opt["huge" + scope].value("2M");
+				size_t unit = 0, size = std::stoull(res, &unit);
+				if (unit < res.size())
+					switch (std::toupper(res[unit])) {
+					case 'K': size <<= 10; break;
+					case 'M': size <<= 20; break;
+					case 'G': size <<= 30; break;
+					}
+				return size;
+			}
+			if (opt("thp" + scope)) return 1;
+		}
+		return 0;
+	};
+	try {
+		mmap::huge<weight::segment>(hugepage("weight"));
+		mmap::huge<cache::block>(hugepage("cache"));
+	} catch (std::exception&) {
+		std::cerr << "invalid huge page size: " << opt << std::endl;
+		std::exit(1);
+	}
 }
 
 void config_weight(utils::options::option opt) {
 	using wght_s = weight::structure;
 	using wght_c = weight::coherence;
+	using wght_k = weight::compact;
 	u32 code = weight::type(), last = code;
+	bool form = wght_k::bfloat(), prev = form;
 	opt += ("alpha=" + opt);
 	if (opt["alpha"].value(0.0 / 0.0) <  1.0) code = wght_s::code;
 	if (opt["alpha"].value(0.0 / 0.0) >= 1.0) code = wght_c::code;
 	if (opt["alpha"]("fix")) code = wght_s::code;
 	if (opt["alpha"]("coh")) code = wght_c::code;
-	if (weight::type(code) == last || weight::wghts().empty()) return;
+	if (opt["alpha"]("f16")) code = wght_k::code, form = opt["alpha"]("bf16");
+	if (opt["alpha"]("i16")) code = weight::quantum16::code;
+	if (opt["alpha"]("i8"))  code = weight::quantum8::code;
+	wght_k::bfloat() = form;
+	if ((weight::type(code) == last && (code != wght_k::code || form == prev)) || weight::wghts().empty()) return;
 
 	weight::container wbuf(std::move(weight::wghts()));
-	for (weight u, w; wbuf.size(); wbuf.erase(u.sign())) { // format existing weights into new scheme
+	for (weight u; wbuf.size(); wbuf.erase(u.sign())) { // format existing weights into new scheme
 		u = wbuf.front();
-		w = weight::make(u.sign(), u.size());
-		switch (code) {
-		case wght_s::code: std::copy_n(u.data<wght_c::unit<0>>(), u.size(), w.data<wght_s>()); break;
-		case wght_c::code: std::copy_n(u.data<wght_s>(), u.size(), w.data<wght_c::unit<0>>()); break;
-		}
+		weight::type(last), wght_k::bfloat() = prev;
+		std::vector<numeric> val = u.numerics();
+		weight::type(code), wght_k::bfloat() = form;
+		weight::make(u.sign(), u.size()).numerics(val, true);
 	}
 	for (feature f : feature::container(std::move(feature::feats()))) { // bind features and weights
 		feature::make(f.value().sign(), f.index().sign());
 	}
 }
 
+class placement {
+public:
+	placement(options::opinion opt, u32 thdnum, bool evaluate) {
+		// pin workers by default only if there are multiple nodes, or if pin is specified
+		bool multi = numa::nodes().size() > 1;
+		if (thdnum <= 1 || opt("nonuma") || !(multi || opt("pin"))) return;
+		cpus = numa::place(thdnum);
+		allow = numa::affinity();
+		if (!multi) return;
+
+		std::vector<int> nodes;
+		for (int cpu : cpus)
+			if (!std::count(nodes.begin(), nodes.end(), numa::node(cpu))) nodes.push_back(numa::node(cpu));
+		auto bytes = [](const weight& w) {
+			switch (weight::type()) {
+			default:
+			case weight::structure::code: return w.size() * sizeof(weight::structure);
+			case weight::coherence::code: return w.size() * sizeof(weight::coherence);
+			case weight::compact::code: return w.size() * sizeof(weight::compact);
+			case weight::quantum16::code: return w.size() * sizeof(weight::quantum16);
+			case weight::quantum8::code: return w.size() * sizeof(weight::quantum8);
+			}
+		};
+		if (shm::enable() && evaluate) { // forked workers of an evaluation read from a node-local replica
+			for (weight w : weight::wghts()) numa::bind(w.data(), bytes(w), nodes.front());
+			for (int node : nodes) {
+				if (node == nodes.front()) continue;
+				numa::affinity(numa::cpus(node)); // first-touch on the node
+				for (weight w : weight::wghts()) {
+					weight& r = replica[node].make(w.sign(), w.size());
+					std::copy_n(w.data<byte>(), bytes(w), r.data<byte>());
+					r.scale(w.scale());
+				}
+			}
+			numa::affinity(allow);
+		} else { // shared tables are interleaved over nodes
+			for (weight w : weight::wghts()) numa::interleave(w.data(), bytes(w), nodes);
+			if (cache::instance().size() > 1)
+				numa::interleave(&cache::instance()[0], cache::instance().size() * sizeof(cache::block), nodes);
+		}
+	}
+	~placement() {
+		if (allow.size()) numa::affinity(allow);
+		for (auto& rep : replica)
+			while (rep.second.size()) rep.second.erase(rep.second.front().sign());
+	}
+
+	void operator()(u32 thdid) const {
+		if (thdid >= cpus.size()) return;
+		numa::bind(cpus[thdid]);
+		auto it = replica.find(numa::node(cpus[thdid]));
+		if (it == replica.end()) return;
+		// rebind features to the replica, only valid in a forked worker
+		weight::wghts() = it->second;
+		for (feature f : feature::container(std::move(feature::feats())))
+			feature::make(f.value().sign(), f.index().sign());
+	}
+
+private:
+	std::vector<int> cpus;
+	std::vector<int> allow;
+	std::map<int, weight::container> replica;
+};
+
 template<typename statistic, typename option = options::option>
 statistic invoke(statistic(*run)(option), option opt) {
 	if (opt("alpha")) config_weight(opt);
 	if (opt("search", "refresh")) cache::refresh();
 	u32 thdnum = opt["thread"].value(1), thdid = thdnum;
+	if (opt("mode", ":sync") || opt("mode", ":replay")) thdnum = thdid = 1; // these modes run their own workers
+	placement place(opt["thread"], thdnum, opt["mode"].value().find("evaluate") == 0);
 #if defined(__linux__)
 	if (shm::enable()) {
 		statistic* stats = shm::alloc<statistic>(thdnum);
 		while ((opt["thread#"] = (--thdid)).value(0) && fork());
+		place(thdid);
 		statistic stat = stats[thdid] = run(opt);
 		if (thdid == 0) while (wait(nullptr) > 0); else std::quick_exit(0);
 		for (u32 i = 1; i < thdnum; i++) stat += stats[i];
@@ -1067,7 +1666,8 @@ statistic invoke(statistic(*run)(option), option opt) {
 #endif
 	std::list<std::future<statistic>> thdpool;
 	while ((opt["thread#"] = (--thdid)).value(0))
-		thdpool.push_back(std::async(std::launch::async, run, opt));
+		thdpool.push_back(std::async(std::launch::async, [=, &place]() { place(thdid); return run(opt); }));
+	place(thdid);
 	statistic stat = run(opt);
 	for (std::future<statistic>& thd : thdpool) stat += thd.get();
 	return stat;
@@ -1112,6 +1712,9 @@ std::string resolve(const std::string& token) {
 	alias["6x6patt"]   = alias["6x6patt/k.matsuzaki"];
 	alias["7x6patt"]   = alias["7x6patt/k.matsuzaki"];
 	alias["8x6patt"]   = alias["8x6patt/k.matsuzaki"];
+#if defined(STATIC_INDEX)
+	alias["custom"]    = ({ std::stringstream in(STATIC_INDEX); std::string s; for (std::string p; in >> p; s += p + ' '); s; });
+#endif
 
 	alias["mono/0123"] = "m@0123[^24]:m@0123,m@37bf,m@fedc,m@c840,m@3210,m@fb73,m@cdef,m@048c ";
 	alias["mono/4567"] = "m@4567[^24]:m@4567,m@26ae,m@ba98,m@d951,m@7654,m@ea62,m@89ab,m@159d ";
@@ -1153,11 +1756,12 @@ void make_network(utils::options::option opt) {
 	std::stringstream unalias(tokens); tokens.clear();
 	for (std::string token; unalias >> token; tokens += (token + ' ')) {
 		if (token.find(':') != npos) continue;
-		std::string name = token.substr(0, token.find_first_of("&|="));
+		std::string name = token.substr(0, token.find_first_of("&|=[("));
 		std::string info = token != name ? token.substr(name.size()) : "";
 		if ((token = utils::resolve(name)).empty() || info.empty()) continue;
 
-		std::string winfo, iinfo, buff;
+		std::string binfo = info.find_first_of("[(") == 0 ? info.substr(0, info.find_first_of("])") + 1) : "";
+		std::string winfo = binfo, iinfo, buff;
 		for (char set : std::string("&|=")) {
 			if (info.find(set) != npos) buff = info.substr(0, info.find_first_of("&|=", info.find(set) + 1)).substr(info.find(set));
 			if (buff.find(set) != npos) winfo += buff.substr(0, buff.find(':'));
@@ -1201,7 +1805,7 @@ void make_network(utils::options::option opt) {
 	std::stringstream unisomorphic(tokens); tokens.clear();
 	for (std::string token; unisomorphic >> token; tokens += (token + ' ')) {
 		if (token.find('!') == npos) {
-			std::string name = token.substr(0, token.find_first_of("&|="));
+			std::string name = token.substr(0, token.find_first_of("&|=[("));
 			if (name.find_first_not_of("0123456789abcdef") == npos && token.find(':') == npos)
 				token += ':' + name + '!';
 			else continue;
@@ -1239,13 +1843,17 @@ void make_network(utils::options::option opt) {
 		std::string itok = token.substr(token.find(':') + 1);
 
 		if (wtok.size()) {
-			// allocate: weight[size] weight(size)
+			// allocate: weight[size] weight(size) weight[sparse] weight[size+sparse]
 			// initialize: ...=0 ...=10000 ...=100000+norm
 			// map or remove: destination={source} id={}
 			for (size_t i; (i = wtok.find_first_of("[]()")) != npos; wtok[i] = ' ');
 			std::string name = wtok.substr(0, wtok.find_first_of("!&|:= "));
 			std::string info = wtok.find(' ') != npos ? wtok.substr(0, wtok.find_first_of("!&|:=")).substr(wtok.find(' ') + 1) : "?";
 			std::string init = wtok.find('=') != npos ? wtok.substr(wtok.find('=') + 1) : "?";
+			bool sparse = info.find("sparse") != npos;
+			if (sparse) info.erase(info.find("sparse"), 6);
+			info.erase(std::remove_if(info.begin(), info.end(), [](char c) { return c == '+' || c == ' '; }), info.end());
+			if (info.empty()) info = "?";
 			std::string sign = wtok.find('&') == npos && wtok.find('|') == npos ? name : ({
 				std::stringstream ss;
 				u64 mska = wtok.find('&') != npos ? std::stoull(wtok.substr(wtok.find('&') + 1), nullptr, 16) : -1ull;
@@ -1279,31 +1887,40 @@ void make_network(utils::options::option opt) {
 			}
 			using wght_s = weight::structure;
 			using wght_c = weight::coherence;
+			using wght_k = weight::compact;
 			if (!weight(sign) && size) { // create new weight table
-				weight dst = weight::make(sign, size);
+				weight& dst = weight::make(sign, size, weight::wghts(), sparse);
 				if (init.find_first_of("{}") != npos && init != "{}") { // copy from existing table
 					weight src(init.substr(0, init.find('}')).substr(init.find('{') + 1));
-					switch (weight::type()) {
+					if (weight::quantized()) dst.numerics(src.numerics(), true);
+					else switch (weight::type()) {
 					default:
 					case wght_s::code: std::copy_n(src.data<wght_s>(), src.size(), dst.data<wght_s>()); break;
 					case wght_c::code: std::copy_n(src.data<wght_c>(), src.size(), dst.data<wght_c>()); break;
+					case wght_k::code: std::copy_n(src.data<wght_k>(), src.size(), dst.data<wght_k>()); break;
 					}
 				} else if (init.find_first_of("0123456789.+-") == 0) { // initialize with specific value
 					numeric val = std::stod(init) * (init.find("norm") != npos ? std::pow(num, -1) : 1);
-					switch (weight::type()) {
+					if (weight::quantized()) dst.numerics(std::vector<numeric>(dst.size(), val), true);
+					else switch (weight::type()) {
 					default:
 					case wght_s::code: std::fill_n(dst.data<wght_s>(), dst.size(), val); break;
 					case wght_c::code: std::fill_n(dst.data<wght_c>(), dst.size(), val); break;
+					case wght_k::code: std::fill_n(dst.data<wght_k>(), dst.size(), val); break;
 					}
 				}
 			} else if (weight(sign) && size) { // table already exists
 				weight dst = weight(sign);
 				if (init.find_first_of("+-") == 0) { // adjust with specific value
 					numeric off = std::stod(init) * (init.find("norm") != npos ? std::pow(num, -1) : 1);
-					switch (weight::type()) {
+					std::vector<numeric> val = weight::quantized() ? dst.numerics() : std::vector<numeric>();
+					for (numeric& v : val) v += off;
+					if (weight::quantized()) dst.numerics(val); // keep the scale, since features may be bound
+					else switch (weight::type()) {
 					default:
 					case wght_s::code: for (numeric& val : dst.value<wght_s>()) val += off; break;
 					case wght_c::code: for (numeric& val : dst.value<wght_c>()) val += off; break;
+					case wght_k::code: for (wght_k& val : dst.value<wght_k>()) val = val + off; break;
 					}
 				}
 			}
@@ -1322,6 +1939,7 @@ void make_network(utils::options::option opt) {
 			});
 			if (!indexer(sign)) {
 				indexer::mapper index = indexer(name).index();
+				if (!index) index = index::pextpt::make(stov(name));
 				if (!index) index = index::adapter(std::bind(index::indexptv, std::placeholders::_1, stov(name)));
 				indexer::make(sign, index);
 			}
@@ -1346,11 +1964,17 @@ void load_network(utils::options::option files) {
 				type = path[path.find_last_of('.') + 1];
 			}
 			if (type == 'w') {
+				weight::mapping(opt.find("mmap") != std::string::npos ? path : "");
 				list<weight> ws = weight::load(in, opt);
+				weight::mapping("");
 				if (opt.find('!') != std::string::npos) { // mark loaded weights as fixed
 					for (weight w : ws) fixed.push_back(w.data());
 				}
-			} else if (type == 'c') cache::load(in, opt);
+			} else if (type == 'c') {
+				cache::mapping(opt.find("mmap") != std::string::npos ? path : "", opt.find("mmap:rw") != std::string::npos);
+				cache::load(in, opt);
+				if (!cache::shared() || !mmap::mapped(&cache::instance()[0])) cache::mapping("");
+			}
 		}
 		in.close();
 	}
@@ -1359,6 +1983,7 @@ void load_network(utils::options::option files) {
 	std::map<std::string, size_t> numof;
 	using wght_s = weight::structure;
 	using wght_c = weight::coherence;
+	using wght_k = weight::compact;
 	while (wghts.size()) { // try ensemble weights with same sign
 		weight w(wghts.front()), m(w.sign(), merge);
 		if (std::find(fixed.begin(), fixed.end(), w.data()) != fixed.end()) { // if w is fixed, never merge
@@ -1383,6 +2008,16 @@ void load_network(utils::options::option files) {
 					m.at<wght_c>(i).updvu += w.at<wght_c>(i).updvu;
 				}
 				break;
+			case wght_k::code: // average incrementally, since the sum may overflow
+				for (size_t i = 0; i < m.size(); i++)
+					m.at<wght_k>(i) = m.at<wght_k>(i) + (w.at<wght_k>(i) - m.at<wght_k>(i)) / (numof[w.sign()] + 1);
+				break;
+			case weight::quantum16::code:
+			case weight::quantum8::code: [&]() { // average incrementally in the scale of the base
+				std::vector<numeric> val = m.numerics(), add = w.numerics();
+				for (size_t i = 0; i < m.size(); i++) val[i] += (add[i] - val[i]) / (numof[w.sign()] + 1);
+				m.numerics(val);
+			}(); break;
 			}
 			wghts.erase(w.sign()); // free this duplicated weight
 			numof[w.sign()] += 1;
@@ -1395,29 +2030,116 @@ void load_network(utils::options::option files) {
 		default:
 		case wght_s::code: for (wght_s& s : m.value<wght_s>()) s.value /= n; break;
 		case wght_c::code: for (wght_c& c : m.value<wght_c>()) c.value /= n; break;
+		case wght_k::code: break; // already averaged
+		case weight::quantum16::code: break;
+		case weight::quantum8::code: break;
 		}
 	}
 	wghts.swap(final);
 }
-void save_network(utils::options::option files) {
+/**
+ * write each file to a temporary file first and rename it, so that a file is never truncated while it is still
+ * mapped (e.g., loaded with mmap as a private mapping), and a failed write never destroys the previous file
+ */
+void save_network(utils::options::option files, const std::string& temp = ".tmp") {
 	for (std::string file : files) {
 		std::string path = file.substr(file.find('|') + 1);
 		std::string opt = path != file ? file.substr(0, file.find('|')) : "";
 		char type = path[path.find_last_of(".") + 1];
 		if (type == 'x' || type == 'l') continue; // .x and .log are suffix for log files
+		if (type == 'c' && cache::shared() && cache::mapping() == path) continue; // already written through the mapping
 		std::ofstream out;
-		out.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+		out.open(path + temp, std::ios::out | std::ios::binary | std::ios::trunc);
 		if (!out.is_open()) continue;
 		// for upward compatibility, we still write legacy binaries for traditional suffixes
+		bool legacy = opt.find("mmap") == std::string::npos; // page-aligned binaries always store its type
 		if (type != 'c') { // .w is reserved for weights binary
-			weight::save(type != 'w' ? out.write("w", 1) : out, opt);
+			weight::save(type != 'w' || !legacy ? out.write("w", 1) : out, opt);
 		} else { // .c is reserved for cache binary
-			cache::save(type != 'c' ?  out.write("c", 1) : out, opt);
+			cache::save(type != 'c' || !legacy ? out.write("c", 1) : out, opt);
 		}
 		out.close();
+		if (out) std::rename((path + temp).c_str(), path.c_str()); // replace the file atomically
+		else std::remove((path + temp).c_str());
 	}
 }
 
+/**
+ * periodic snapshots of weights during optimization, every UNIT statistic units and/or every TIME (e.g., 30m)
+ * a forked child writes the snapshot to temporary files and renames them, so that the training is not blocked
+ * and a crash never leaves a half-written file; note that private tables are copy-on-write in the child, while
+ * SHM tables are shared, i.e., the snapshot may include some updates made during the writing
+ * the child is forked from a multithreaded process, so it must write the snapshot without creating threads
+ */
+class checkpoint {
+public:
+	static void config(std::string spec, options::option files) {
+		checkpoint& ckpt = instance();
+		ckpt.files = {};
+		ckpt.units = ckpt.period = 0;
+		for (std::string file : files)
+			if (file[file.find_last_of('.') + 1] == 'w') ckpt.files += file;
+		std::replace(spec.begin(), spec.end(), ',', ' ');
+		std::stringstream tokens(spec);
+		for (std::string token; tokens >> token; ) {
+			size_t n = 0;
+			u64 v = 0;
+			try {
+				if (!std::isdigit(token[0])) throw std::invalid_argument("checkpoint");
+				v = std::stoull(token, &n);
+				if (token.size() - n > 1 || (n < token.size() && token[n] != 's' && token[n] != 'm' && token[n] != 'h'))
+					throw std::invalid_argument("checkpoint");
+			} catch (std::exception&) {
+				std::cerr << "invalid checkpoint: " << token << std::endl;
+				std::exit(1);
+			}
+			switch (n < token.size() ? token[n] : 0) {
+			case 's': ckpt.period = v * 1000; break;
+			case 'm': ckpt.period = v * 60000; break;
+			case 'h': ckpt.period = v * 3600000; break;
+			default:  ckpt.units = v; break;
+			}
+		}
+		ckpt.last = moporgic::millisec();
+	}
+
+	/**
+	 * take a snapshot if due, should be invoked by the first worker once a statistic unit is done
+	 * a snapshot is skipped if the previous one is still being written
+	 */
+	static void invoke(u64 unit) {
+		checkpoint& ckpt = instance();
+		if (ckpt.files.empty()) return;
+		u64 tick = moporgic::millisec();
+		if (!(ckpt.units && unit % ckpt.units == 0) && !(ckpt.period && tick - ckpt.last >= ckpt.period)) return;
+		if (ckpt.child > 0 && waitpid(ckpt.child, nullptr, WNOHANG) == 0) return;
+		ckpt.last = tick;
+		ckpt.child = fork();
+		if (ckpt.child != 0) return;
+		weight::helpers() = 0; // only the forking thread survives in the child, so never start threads there
+		save_network(ckpt.files);
+		std::_Exit(0);
+	}
+
+	/**
+	 * wait for the snapshot being written, so that it never replaces a later save
+	 */
+	static void finish() {
+		checkpoint& ckpt = instance();
+		if (ckpt.child > 0) waitpid(ckpt.child, nullptr, 0);
+		ckpt.child = 0;
+	}
+
+private:
+	static checkpoint& instance() { static checkpoint ckpt; return ckpt; }
+
+	options::option files;
+	u64 units = 0;
+	u64 period = 0;
+	u64 last = 0;
+	pid_t child = 0;
+};
+
 void list_network() {
 	if (weight::wghts().empty()) return;
 
@@ -1429,6 +2151,7 @@ void list_network() {
 		buf << "[";
 		buf << (w.size() / std::pow(2, p * 10));
 		buf << ("\0\0k\0M\0G\0T\0" + (p << 1));
+		if (w.sparse()) buf << ",sparse";
 		buf << "]";
 
 		buf << " :";
@@ -1444,16 +2167,179 @@ void list_network() {
 	std::cout << std::endl;
 }
 
+void list_memory() {
+	auto usage = [](const std::string& what, mmap::usage use) -> std::string {
+		auto unit = [](size_t size) {
+			u32 p = math::log2(size ?: 1) / 10;
+			return format("%g%c", size / std::pow(2, p * 10), " KMGT"[p]);
+		};
+		if (use.size == 0) return what + " n/a";
+		if (use.page > mmap::page()) return what + " hugetlb " + unit(use.page);
+		if (use.huge) return what + " THP " + unit(mmap::pmd()) + format(" (%.0f%%)", 100.0 * use.huge / use.size);
+		return what + " " + unit(use.page);
+	};
+	std::vector<const void*> wghts;
+	for (weight w : weight::wghts()) wghts.push_back(w.data());
+	auto wu = mmap::status(wghts.begin(), wghts.end());
+	auto cu = cache::instance().size() > 1 ? mmap::status({ &cache::instance()[0] }) : mmap::usage();
+	std::cout << "page = " << usage("weight", wu) << ", " << usage("cache", cu) << std::endl;
+	std::cout << std::endl;
+}
+
 } // utils
 
 
 struct method {
 	typedef numeric(*estimator)(const board&, clip<feature>);
 	typedef numeric(*optimizer)(const board&, numeric, clip<feature>);
+	typedef void(*estimators)(const board*, numeric*, u32, clip<feature>);
+	typedef void(*locator)(const board&, numeric**, clip<feature>);
 
 	estimator estim;
 	optimizer optim;
-	constexpr inline method(estimator estim = estimate, optimizer optim = optimize) : estim(estim), optim(optim) {}
+	estimators estis;
+	locator locate; // for isomorphic features only, see isomorphic::locate
+
+	/**
+	 * per-thread counters of the time-controlled search by the depth (ply) reached, i.e., moves and their latency in microseconds
+	 */
+	struct reach {
+		std::array<u64, 16> moves, time, peak;
+		reach& operator +=(const reach& rh) {
+			for (u32 i = 0; i < 16; i++) {
+				moves[i] += rh.moves[i];
+				time[i] += rh.time[i];
+				peak[i] = std::max(peak[i], rh.peak[i]);
+			}
+			return *this;
+		}
+		void record(u32 ply, u64 usec) {
+			ply = std::min(ply, 15u);
+			moves[ply] += 1;
+			time[ply] += usec;
+			peak[ply] = std::max(peak[ply], usec);
+		}
+		static inline reach& local() { static thread_local reach rh = {}; return rh; }
+	};
+
+	/**
+	 * per-thread counters of max nodes in the search by depth, i.e., afterstates expanded and duplicates skipped
+	 */
+	struct nodes {
+		std::array<u64, 16> expand, dedup;
+		nodes& operator +=(const nodes& nd) {
+			for (u32 i = 0; i < 16; i++) {
+				expand[i] += nd.expand[i];
+				dedup[i] += nd.dedup[i];
+			}
+			return *this;
+		}
+		static inline nodes& local() { static thread_local nodes nd = {}; return nd; }
+	};
+
+	/**
+	 * per-thread write combining of updates for parallel training, where an entry is buffered only if it is updated
+	 * again before its slot is taken (i.e., hot), so that repeated updates of hot entries are merged into a single
+	 * write, while other entries are written directly as usual; merged updates are written back when evicted or
+	 * flushed (after each episode), where the flush uses atomic adds, whose retries (i.e., another worker has written
+	 * the entry in between) are counted per table
+	 */
+	struct delta {
+		struct counter {
+			std::array<u64, 32> update, merge, write, retry;
+			counter& operator +=(const counter& ct) {
+				for (u32 i = 0; i < 32; i++) {
+					update[i] += ct.update[i];
+					merge[i] += ct.merge[i];
+					write[i] += ct.write[i];
+					retry[i] += ct.retry[i];
+				}
+				return *this;
+			}
+			static inline counter& local() { static thread_local counter ct = {}; return ct; }
+		};
+		struct slot { numeric* addr; numeric diff; u32 id; };
+
+		// the configuration is also per thread, since workers (e.g., with noshm) may enable it while others are training
+		static inline u32& size() { static thread_local u32 size = 0; return size; }
+		static inline locator& locate() { static thread_local locator locate = nullptr; return locate; }
+		static inline std::vector<std::pair<numeric*, numeric*>>& tables() { static thread_local std::vector<std::pair<numeric*, numeric*>> t; return t; }
+		static inline std::vector<slot>& slots() { static thread_local std::vector<slot> slots; return slots; }
+
+		static optimizer enable(u32 size, locator locate = nullptr) {
+			delta::size() = 1u << math::log2(std::max(size, 1u));
+			delta::locate() = locate;
+			tables().clear();
+			for (weight w : weight::wghts())
+				tables().emplace_back(w.data<numeric>(), w.data<numeric>() + w.size());
+			return delta::optimize;
+		}
+
+		static numeric optimize(const board& state, numeric error, clip<feature> range = feature::feats()) {
+			std::vector<slot>& buf = slots();
+			if (buf.size() != size()) buf.assign(size(), { nullptr, 0, 0 });
+			numeric* addr[range.size() + 1];
+			if (locate()) { // the same addresses as estimates, in any order
+				board iso[8];
+				state.isochain64(iso);
+				for (u32 k = 0; k < 8; k++) locate()(iso[k], addr + k, range);
+			} else {
+				for (u32 i = 0; i < range.size(); i++) addr[i] = pointer_cast<numeric>(&range[i].at<weight::structure>(state));
+			}
+			numeric esti = 0;
+			counter& ct = counter::local();
+			for (u32 i = 0, id = 0; i < range.size(); i++) {
+				if (!locate() || !(i & 7)) id = table(addr[i]); // all isomorphisms of a group share a table
+				esti += add(buf, ct, addr[i], error, id);
+			}
+			return esti;
+		}
+
+		static inline u32 table(const numeric* addr) {
+			u32 id = 0;
+			for (auto& t : tables()) {
+				if (addr >= t.first && addr < t.second) break;
+				id++;
+			}
+			return std::min(id, 31u);
+		}
+
+		static inline_always numeric add(std::vector<slot>& buf, counter& ct, numeric* addr, numeric diff, u32 id) {
+			slot& s = buf[(uintptr_t(addr) / sizeof(numeric)) & (buf.size() - 1)];
+			if (s.addr == addr) { // hot: merge into the buffer
+				ct.update[s.id]++;
+				ct.merge[s.id]++;
+				s.diff += diff;
+				return *addr + s.diff;
+			}
+			ct.update[id]++;
+			ct.write[id]++;
+			if (s.diff) write(s.addr, s.diff, s.id); // evict
+			s = { addr, 0, id };
+			return *addr += diff;
+		}
+
+		static void flush() {
+			for (slot& s : slots()) {
+				if (s.diff) write(s.addr, s.diff, s.id);
+				s.diff = 0;
+			}
+		}
+
+		static inline void write(numeric* addr, numeric diff, u32 id) {
+			typedef typename std::conditional<sizeof(numeric) == 8, u64, u32>::type word;
+			word* raw = pointer_cast<word>(addr);
+			word old = __atomic_load_n(raw, __ATOMIC_RELAXED), val;
+			do {
+				numeric sum = raw_cast<numeric>(old) + diff;
+				val = raw_cast<word>(sum);
+			} while (!__atomic_compare_exchange_n(raw, &old, val, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED) && ++counter::local().retry[id]);
+			counter::local().write[id]++;
+		}
+	};
+
+	constexpr inline method(estimator estim = estimate, optimizer optim = optimize, estimators estis = nullptr, locator locate = nullptr) :
+		estim(estim), optim(optim), estis(estis), locate(locate) {}
 	constexpr inline operator estimator() const { return estim; }
 	constexpr inline operator optimizer() const { return optim; }
 
@@ -1472,7 +2358,7 @@ struct method {
 
 	template<typename mode = weight::segment>
 	struct common {
-		constexpr inline operator method() { return { common<mode>::estimate, common<mode>::optimize }; }
+		constexpr inline operator method() { return { common<mode>::estimate, common<mode>::optimize, common<mode>::estimates }; }
 
 		constexpr static inline numeric estimate(const board& state, clip<feature> range = feature::feats()) {
 			numeric esti = 0;
@@ -1486,11 +2372,52 @@ struct method {
 				esti += (feat.at<mode>(state) += error);
 			return esti;
 		}
+
+		static inline void estimates(const board* state, numeric* esti, u32 num, clip<feature> range = feature::feats()) {
+			// locate (and prefetch) all values of the batch first, then gather them
+			mode* addr[num * range.size() + 1];
+			for (u32 i = 0, k = 0; i < num; i++) {
+				for (feature& feat : range) {
+					addr[k] = &feat.at<mode>(state[i]);
+					__builtin_prefetch(addr[k++]);
+				}
+			}
+			for (u32 i = 0, k = 0; i < num; i++) {
+				esti[i] = 0;
+				for (u32 n = range.size(); n; n--) esti[i] += *(addr[k++]);
+			}
+		}
+	};
+
+	struct gather {
+		typedef numeric(*kernel)(numeric* const*, u32);
+
+		// sum up n groups of 8 values, where addr[j * 8 + k] is the value of the j-th group under the k-th isomorphism
+		// each isomorphism is accumulated over groups first, then the 8 isomorphisms are summed, both in order
+		static inline numeric scalar(numeric* const* addr, u32 n) {
+			numeric esti = 0;
+			for (u32 k = 0; k < 8; k++) {
+				numeric iso = *(addr[k]);
+				for (u32 j = 1; j < n; j++) iso += *(addr[(j << 3) + k]);
+				esti += iso;
+			}
+			return esti;
+		}
+		// same as scalar, but the addresses point to compact values
+		static inline numeric widen(numeric* const* addr, u32 n) {
+			numeric esti = 0;
+			for (u32 k = 0; k < 8; k++) {
+				numeric iso = *pointer_cast<weight::compact>(addr[k]);
+				for (u32 j = 1; j < n; j++) iso += *pointer_cast<weight::compact>(addr[(j << 3) + k]);
+				esti += iso;
+			}
+			return esti;
+		}
 	};
 
 	template<typename mode = weight::segment>
 	struct isomorphic {
-		constexpr inline operator method() { return { isomorphic::estimate, isomorphic::optimize }; }
+		constexpr inline operator method() { return { isomorphic::estimate, isomorphic::optimize, isomorphic::estimates, isomorphic::locate }; }
 
 		constexpr static inline_always numeric invoke(const board& iso, clip<feature> f) {
 			numeric esti = 0;
@@ -1505,39 +2432,61 @@ struct method {
 			return esti;
 		}
 
+		constexpr static inline_always void locate(const board& iso, numeric** addr, clip<feature> f) {
+			for (feature* feat = f.begin(); feat != f.end(); feat += 8, addr += 8)
+				__builtin_prefetch(*addr = pointer_cast<numeric>(&feat->at<mode>(iso)));
+		}
+
+		template<locator locate = isomorphic::locate>
+		static inline void estimates(const board* state, numeric* esti, u32 num, clip<feature> range = feature::feats()) {
+			// locate (and prefetch) all values of the batch first, then gather them in the same order as estimate
+			// the values of the i-th state are stored as addr[i * 8n + j * 8 + k] for the j-th group under the k-th isomorphism
+			u32 n = range.size() >> 3;
+			numeric* addr[num * range.size() + 1];
+			for (u32 i = 0; i < num; i++) {
+				board iso[8];
+				state[i].isochain64(iso);
+				for (u32 k = 0; k < 8; k++) locate(iso[k], addr + i * range.size() + k, range);
+			}
+			gather::kernel sum = std::is_same<mode, weight::compact>::value ? gather::widen : gather::scalar;
+			for (u32 i = 0; i < num; i++)
+				esti[i] = n ? sum(addr + i * range.size(), n) : 0;
+		}
+
 		template<estimator estim = isomorphic::invoke>
 		constexpr static inline numeric estimate(const board& state, clip<feature> range = feature::feats()) {
 			numeric esti = 0;
-			board iso;
-			esti += estim(({ iso = state;     iso; }), range);
-			esti += estim(({ iso.flip();      iso; }), range);
-			esti += estim(({ iso.transpose(); iso; }), range);
-			esti += estim(({ iso.flip();      iso; }), range);
-			esti += estim(({ iso.transpose(); iso; }), range);
-			esti += estim(({ iso.flip();      iso; }), range);
-			esti += estim(({ iso.transpose(); iso; }), range);
-			esti += estim(({ iso.flip();      iso; }), range);
+			board iso[8];
+			state.isochain64(iso);
+			esti += estim(iso[0], range);
+			esti += estim(iso[1], range);
+			esti += estim(iso[2], range);
+			esti += estim(iso[3], range);
+			esti += estim(iso[4], range);
+			esti += estim(iso[5], range);
+			esti += estim(iso[6], range);
+			esti += estim(iso[7], range);
 			return esti;
 		}
 		template<optimizer optim = isomorphic::invoke>
 		constexpr static inline numeric optimize(const board& state, numeric updv, clip<feature> range = feature::feats()) {
 			numeric esti = 0;
-			board iso;
-			esti += optim(({ iso = state;     iso; }), updv, range);
-			esti += optim(({ iso.flip();      iso; }), updv, range);
-			esti += optim(({ iso.transpose(); iso; }), updv, range);
-			esti += optim(({ iso.flip();      iso; }), updv, range);
-			esti += optim(({ iso.transpose(); iso; }), updv, range);
-			esti += optim(({ iso.flip();      iso; }), updv, range);
-			esti += optim(({ iso.transpose(); iso; }), updv, range);
-			esti += optim(({ iso.flip();      iso; }), updv, range);
+			board iso[8];
+			state.isochain64(iso);
+			esti += optim(iso[0], updv, range);
+			esti += optim(iso[1], updv, range);
+			esti += optim(iso[2], updv, range);
+			esti += optim(iso[3], updv, range);
+			esti += optim(iso[4], updv, range);
+			esti += optim(iso[5], updv, range);
+			esti += optim(iso[6], updv, range);
+			esti += optim(iso[7], updv, range);
 			return esti;
 		}
 
 		template<indexer::mapper... indexes>
 		struct static_index {
 			constexpr static std::array<indexer::mapper, sizeof...(indexes)> index = { indexes... };
-			constexpr inline operator method() { return { static_index::estimate, static_index::optimize }; }
 
 			template<indexer::mapper index, indexer::mapper... follow> constexpr static
 			inline_always typename std::enable_if<(sizeof...(follow) != 0), numeric>::type invoke(const board& iso, clip<feature> f) {
@@ -1556,8 +2505,23 @@ struct method {
 				return (f[(sizeof...(indexes) - sizeof...(follow) - 1) << 3].at<mode>(index(iso)) += updv);
 			}
 
+			template<indexer::mapper index, indexer::mapper... follow> constexpr static
+			inline_always typename std::enable_if<(sizeof...(follow) != 0), void>::type locate(const board& iso, numeric** addr, clip<feature> f) {
+				// addresses are stored in reverse order, so that gathering them matches the sum order of invoke
+				mode& v = f[(sizeof...(indexes) - sizeof...(follow) - 1) << 3].at<mode>(index(iso));
+				__builtin_prefetch(addr[sizeof...(follow) << 3] = pointer_cast<numeric>(&v));
+				locate<follow...>(iso, addr, f);
+			}
+			template<indexer::mapper index, indexer::mapper... follow> constexpr static
+			inline_always typename std::enable_if<(sizeof...(follow) == 0), void>::type locate(const board& iso, numeric** addr, clip<feature> f) {
+				mode& v = f[(sizeof...(indexes) - sizeof...(follow) - 1) << 3].at<mode>(index(iso));
+				__builtin_prefetch(addr[sizeof...(follow) << 3] = pointer_cast<numeric>(&v));
+			}
+
+			constexpr inline operator method() { return { static_index::estimate, static_index::optimize, static_index::estimates, locate<indexes...> }; }
 			constexpr static estimator estimate = isomorphic::estimate<invoke<indexes...>>;
 			constexpr static optimizer optimize = isomorphic::optimize<invoke<indexes...>>;
+			constexpr static estimators estimates = isomorphic::estimates<locate<indexes...>>;
 		};
 
 		typedef typename isomorphic<mode>::template static_index<
@@ -1607,11 +2571,122 @@ struct method {
 		typedef typename isomorphic<mode>::template static_index<
 				index::indexpt<0x0,0x1,0x2,0x3,0x4,0x5,0x6,0x7>,
 				index::indexpt<0x4,0x5,0x6,0x7,0x8,0x9,0xa,0xb>> idx2x8patt;
+
+#if defined(STATIC_INDEX)
+		/**
+		 * the static index of a custom network, e.g., build with STATIC_INDEX="\"0123 4567 0145\""
+		 * patterns are separated by spaces, each of which is a list of 1 to 8 hexadecimal tile positions
+		 */
+		struct static_index_spec {
+			constexpr static const char* spec = STATIC_INDEX;
+
+			constexpr static u32 hex(char c) {
+				return (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1u;
+			}
+			constexpr static u32 count() {
+				u32 n = 0;
+				for (u32 i = 0; spec[i]; i++) n += (spec[i] != ' ') && (i == 0 || spec[i - 1] == ' ');
+				return n;
+			}
+			constexpr static u32 find(u32 k) { // offset of the kth pattern
+				for (u32 i = 0, n = 0; spec[i]; i++)
+					if ((spec[i] != ' ') && (i == 0 || spec[i - 1] == ' ') && n++ == k) return i;
+				return -1u;
+			}
+			constexpr static u32 size(u32 k) {
+				u32 i = find(k), n = 0;
+				while (spec[i + n] && spec[i + n] != ' ') n++;
+				return n;
+			}
+			constexpr static u32 tile(u32 k, u32 i) { return hex(spec[find(k) + i]); }
+
+			template<u32 k, u32... i>
+			constexpr static indexer::mapper mapper(std::integer_sequence<u32, i...>) {
+				static_assert(sizeof...(i) >= 1 && sizeof...(i) <= 8 && ((tile(k, i) < 16) && ...), "invalid STATIC_INDEX");
+				return index::indexpt<tile(k, i)...>;
+			}
+			template<u32... k>
+			constexpr static auto make(std::integer_sequence<u32, k...>) ->
+				static_index<mapper<k>(std::make_integer_sequence<u32, size(k)>())...>;
+		};
+		typedef decltype(static_index_spec::make(std::make_integer_sequence<u32, static_index_spec::count()>())) idxcustom;
+#endif
 	};
 
+	/**
+	 * estimators of quantized networks, which sum up the integers of a table and then rescale once
+	 * updates are rounded to the nearest unit (i.e., small updates are lost), so quantized networks are for evaluation
+	 */
+	template<typename mode = weight::quantum16>
+	struct quantized {
+		constexpr inline operator method() { return { quantized::estimate, quantized::optimize }; }
+
+		static inline numeric estimate(const board& state, clip<feature> range = feature::feats()) {
+			numeric esti = 0;
+			for (feature& feat : range)
+				esti += feat.at<mode>(state) * feat.scale();
+			return esti;
+		}
+		static inline numeric optimize(const board& state, numeric updv, clip<feature> range = feature::feats()) {
+			numeric esti = 0;
+			for (feature& feat : range) {
+				mode& v = feat.at<mode>(state);
+				v = i32(std::lround(v + updv / feat.scale()));
+				esti += v * feat.scale();
+			}
+			return esti;
+		}
+
+		struct isomorphic {
+			constexpr inline operator method() { return { isomorphic::estimate, isomorphic::optimize }; }
+			static inline numeric estimate(const board& state, clip<feature> range = feature::feats()) {
+				numeric esti = 0;
+				board iso[8];
+				state.isochain64(iso);
+				for (feature* feat = range.begin(); feat != range.end(); feat += 8) {
+					i32 sum = 0;
+					for (u32 k = 0; k < 8; k++) sum += feat->at<mode>(iso[k]);
+					esti += sum * feat->scale();
+				}
+				return esti;
+			}
+			constexpr static optimizer optimize = quantized::optimize;
+		};
+
+		template<typename statics> // the static_index of method::isomorphic
+		struct static_index {
+			template<u32 i> static inline_always numeric invoke(const board* iso, clip<feature> f) {
+				constexpr indexer::mapper index = statics::index[i];
+				feature& feat = f[i << 3];
+				i32 sum = 0;
+				for (u32 k = 0; k < 8; k++) sum += feat.at<mode>(index(iso[k]));
+				return sum * feat.scale();
+			}
+			template<u32 i, u32... follow> static inline_always numeric invoke(const board* iso, clip<feature> f, std::integer_sequence<u32, i, follow...>) {
+				return invoke<i>(iso, f) + invoke(iso, f, std::integer_sequence<u32, follow...>());
+			}
+			static inline_always numeric invoke(const board* iso, clip<feature> f, std::integer_sequence<u32>) { return 0; }
+
+			constexpr inline operator method() { return { static_index::estimate, static_index::optimize }; }
+			static inline numeric estimate(const board& state, clip<feature> range = feature::feats()) {
+				board iso[8];
+				state.isochain64(iso);
+				return invoke(iso, range, std::make_integer_sequence<u32, statics::index.size()>());
+			}
+			constexpr static optimizer optimize = quantized::optimize;
+		};
+	};
+
+	template<typename source> struct symmetric : std::true_type {}; // whether source gives isomorphic boards the same value
+	template<typename mode> struct symmetric<common<mode>> : std::false_type {};
+	template<typename mode> struct symmetric<quantized<mode>> : std::false_type {};
+
 	template<typename source = common<weight::segment>>
 	struct expectimax {
-		constexpr inline operator method() { return { expectimax<source>::estimate, expectimax<source>::optimize }; }
+		constexpr inline operator method() {
+			method::estimators estis = budget() ? expectimax<source>::deepen : prune() ? expectimax<source>::estimates : nullptr;
+			return { expectimax<source>::estimate, expectimax<source>::optimize, estis };
+		}
 		constexpr inline expectimax(utils::options::option opt) {
 			std::stringstream input;
 			auto next = [&](u32 n) -> u32 {
@@ -1624,42 +2699,283 @@ struct method {
 			};
 			input.str(opt["search"].value());
 			u32 n = expectimax<source>::depth(next(1) | 1);
+			std::string time = opt["search"].value();
+			time = time.substr(0, time.find(' '));
+			size_t unit = time.find("ms");
+			if (unit != std::string::npos && unit && unit + 2 == time.size()
+					&& time.find_first_not_of("0123456789") == unit) { // time-controlled, e.g., 10ms
+				expectimax<source>::budget() = std::stoul(time);
+				n = expectimax<source>::depth(15);
+			}
 			std::string limit = input.str() + " limit=";
 			limit = limit.substr(limit.find("limit=") + 6);
 			std::replace(limit.begin(), limit.end(), ',', ' ');
 			input.clear(), input.str(limit);
 			for (u32& lim : expectimax<source>::limit())
 				lim = n = std::min(next(n) & -2u, n);
+			std::string split = opt["search"].value() + " split=";
+			expectimax<source>::split() = std::max(std::stoul("0" + split.substr(split.find("split=") + 6)), 1ul);
+			std::string prob = opt["search"].value() + " prob=";
+			expectimax<source>::cutoff() = std::stod("0" + prob.substr(prob.find("prob=") + 5));
+			std::string prune = opt["search"].value();
+			if ((expectimax<source>::prune() = prune.find("prune") != std::string::npos)) {
+				input.clear(), input.str(prune.substr(prune.find("prune") + 5) + " ");
+				numeric upper = 0;
+				for (feature f : feature::feats()) { // the upper bound of the network
+					numeric max = 0;
+					if (weight::type() == weight::coherence::code)
+						for (numeric v : f.value().value<weight::coherence>()) max = std::max(max, v);
+					else if (weight::type() == weight::compact::code)
+						for (numeric v : f.value().value<weight::compact>()) max = std::max(max, v);
+					else if (weight::type() == weight::quantum16::code)
+						for (i32 v : f.value().value<weight::quantum16>()) max = std::max(max, v * f.scale());
+					else if (weight::type() == weight::quantum8::code)
+						for (i32 v : f.value().value<weight::quantum8>()) max = std::max(max, v * f.scale());
+					else
+						for (numeric v : f.value().value<weight::structure>()) max = std::max(max, v);
+					upper += max;
+				}
+				if (input.peek() == '=') upper = std::stod(prune.substr(prune.find("prune=") + 6));
+				expectimax<source>::upper() = upper;
+			}
 		}
 
-		static inline numeric search_expt(const board& after, u32 depth, clip<feature> range = feature::feats()) {
+		static inline numeric search_expt(const board& after, u32 depth, clip<feature> range = feature::feats(), numeric prob = 1) {
 			numeric expt = 0;
 			u64it slots = after.where(0);
 			u32 empty = slots.size();
 			depth = std::min(depth, limit(empty));
 			cache::block::access lookup = cache::find(after, depth);
 			if (lookup) return lookup.fetch();
-			if (!depth) return source::estimate(after, range);
+			if (!depth || prob < cutoff()) return source::estimate(after, range);
+			if (expired(depth)) return 0;
 			for (u64 slot; (slot = *slots) != 0; slots++) {
-				expt += 0.9 * search_best(u64(after) | (slot << 0), depth - 1, range);
-				expt += 0.1 * search_best(u64(after) | (slot << 1), depth - 1, range);
+				expt += 0.9 * search_best(u64(after) | (slot << 0), depth - 1, range, prob * 0.9 / empty);
+				expt += 0.1 * search_best(u64(after) | (slot << 1), depth - 1, range, prob * 0.1 / empty);
 			}
+			if (expired()) return 0; // never store an incomplete result
 			expt = lookup.store(expt / empty);
 			return expt;
 		}
 
-		static inline numeric search_best(const board& before, u32 depth, clip<feature> range = feature::feats()) {
+		static inline numeric search_best(const board& before, u32 depth, clip<feature> range = feature::feats(), numeric prob = 1) {
 			numeric best = 0, expt, esti;
-			for (const board& after : before.moves<board>()) {
-				if (after.info() == -1u) continue;
-				expt = search_expt(after, depth - 1, range);
+			board moves[4];
+			if (expired(depth)) return 0;
+			for (u32 i = 0, num = expand(before, moves, depth, range); i < num; i++) {
+				const board& after = moves[i];
+				expt = search_expt(after, depth - 1, range, prob);
 				esti = after.info() + std::max(expt, numeric(0));
 				best = std::max(best, esti + 1);
 			}
 			return best;
 		}
 
+		/**
+		 * the afterstates to be searched at a max node, in which those equal under isomorphism (with the same reward)
+		 * are expanded only once and, with pruning, ordered by the static estimate so that the most promising one goes
+		 * first; both are skipped right above the leaves, where they would cost more than evaluating the leaves
+		 * note that isomorphic afterstates only share a value if the network is symmetric or they share a TT entry
+		 */
+		static inline u32 expand(const board& before, board* moves, u32 depth, clip<feature> range = feature::feats()) {
+			board after[4];
+			u64 canon[4];
+			u32 num = 0, dup = 0;
+			before.moves(after);
+			for (u32 i = 0; i < 4; i++) {
+				if (after[i].info() == -1u) continue;
+				if (depth < 3 || !(symmetric<source>::value || cache::instance().size() > 1)) { moves[num++] = after[i]; continue; }
+				board iso(after[i]);
+				iso.isomin64();
+				u32 k = 0;
+				while (k < num && (canon[k] != u64(iso) || moves[k].info() != after[i].info())) k++;
+				if (k < num) { dup++; continue; }
+				canon[num] = iso;
+				moves[num++] = after[i];
+			}
+			if (prune() && depth >= 3 && num > 1) {
+				numeric esti[4];
+				for (u32 i = 0; i < num; i++) esti[i] = moves[i].info() + source::estimate(moves[i], range);
+				for (u32 i = 1; i < num; i++) // insertion sort, descending
+					for (u32 k = i; k > 0 && esti[k - 1] < esti[k]; k--)
+						std::swap(esti[k - 1], esti[k]), std::swap(moves[k - 1], moves[k]);
+			}
+			method::nodes::local().expand[std::min(depth, 15u)] += num;
+			method::nodes::local().dedup[std::min(depth, 15u)] += dup;
+			return num;
+		}
+
+		/**
+		 * search the root chance node with helper threads, the tasks are the moves after each possible tile
+		 * results are combined in the same order as search_expt and search_best, so they are identical
+		 */
+		static inline numeric search_split(const board& after, u32 depth, clip<feature> range = feature::feats()) {
+			u64it slots = after.where(0);
+			u32 empty = slots.size();
+			depth = std::min(depth, limit(empty));
+			cache::block::access lookup = cache::find(after, depth);
+			if (lookup) return lookup.fetch();
+			if (!depth) return source::estimate(after, range);
+
+			board moved[32][4];
+			numeric estis[32][4];
+			for (u32 i = 0; i < empty; i++) {
+				u64 slot = slots[i];
+				board(u64(after) | (slot << 0)).moves(moved[i * 2 + 0]);
+				board(u64(after) | (slot << 1)).moves(moved[i * 2 + 1]);
+			}
+			static thread_local moporgic::pool helper;
+			helper.resize(split() - 1);
+			u8 epoch = cache::epoch();
+			u64 deadline = expectimax<source>::deadline();
+			bool late = false;
+			cache::stats stats = {};
+			std::mutex lock;
+			helper.run(empty * 8, [&](size_t i) {
+				cache::epoch() = epoch;
+				if (!expired()) expectimax<source>::deadline() = deadline;
+				const board& next = moved[i >> 2][i & 3];
+				numeric prob = ((i & 4) ? 0.1 : 0.9) / empty;
+				if (next.info() != -1u) estis[i >> 2][i & 3] = search_expt(next, depth - 2, range, prob);
+			}, [&]() {
+				std::lock_guard<std::mutex> guard(lock);
+				stats += cache::stats::local();
+				cache::stats::local() = {};
+				late = late || expired();
+				expectimax<source>::deadline() = 0;
+			});
+			cache::stats::local() += stats;
+			expectimax<source>::deadline() = late ? 1 : deadline;
+			if (expired()) return 0;
+
+			numeric expt = 0;
+			for (u32 i = 0; i < empty * 2; i++) {
+				numeric best = 0, esti;
+				for (u32 k = 0; k < 4; k++) {
+					if (moved[i][k].info() == -1u) continue;
+					esti = moved[i][k].info() + std::max(estis[i][k], numeric(0));
+					best = std::max(best, esti + 1);
+				}
+				expt += ((i & 1) ? 0.1 : 0.9) * best;
+			}
+			expt = lookup.store(expt / empty);
+			return expt;
+		}
+
+		/**
+		 * bounded search with Star1 cutoffs, in which only the results within the window (lo, hi) are exact
+		 * a cut result is a bound (cut < 0: upper bound no more than lo; cut > 0: lower bound no less than hi),
+		 * which is cached as a bound entry; exact results are identical to search_expt and search_best
+		 * a result is cut whenever any of its children is, and bounds are never clamped to the window, so that
+		 * they remain valid bounds even if rounding puts them slightly outside it
+		 */
+		static inline numeric bound_expt(const board& after, u32 depth, numeric lo, numeric hi, i32& cut, clip<feature> range, numeric prob = 1) {
+			u64it slots = after.where(0);
+			u32 empty = slots.size();
+			depth = std::min(depth, limit(empty));
+			cut = 0;
+			cache::block::access lookup = cache::find(after, depth);
+			if (lookup) return lookup.fetch();
+			if (lookup.bound() == 1 && lookup.fetch() <= lo) return cut = -1, lookup.fetch();
+			if (lookup.bound() == 2 && lookup.fetch() >= hi) return cut = +1, lookup.fetch();
+			if (!depth || prob < cutoff()) return source::estimate(after, range);
+			if (expired(depth)) return 0;
+
+			// values of search_best are bounded by [0, rewards of the remaining moves + the upper bound of the network]
+			// a move rewards no more than the sum of tiles, which grows by at most 4 per layer
+			hex num = after.numof();
+			u32 sum = 0, m = depth / 2;
+			for (u32 t = 1; t < 16; t++) sum += num[t] << t;
+			numeric upper = m * (sum + 1) + 2 * m * (m + 1) + std::max(expectimax<source>::upper(), numeric(0));
+
+			numeric best[32];
+			double part = 0, rest = 1; // the weighted sum of searched children, and the probability of the rest
+			for (u32 t = 0; t < 2; t++) { // search the more probable children first
+				double p = (t ? 0.1 : 0.9) / empty;
+				for (u32 i = 0; i < empty; i++) {
+					rest -= p;
+					numeric a = (lo - part - rest * upper) / p, b = (hi - part) / p;
+					numeric esti = best[i * 2 + t] = bound_best(u64(after) | (slots[i] << t), depth - 1, a, b, cut, range, prob * p);
+					if (expired()) return cut = 0, 0; // never store an incomplete result
+					part += p * esti;
+					if (!cut && part + rest * upper <= lo) cut = -1;
+					if (!cut && part >= hi) cut = 1;
+					if (cut) return lookup.store(cut < 0 ? numeric(part + rest * upper) : numeric(part), cut < 0 ? 1 : 2);
+				}
+			}
+			numeric expt = 0;
+			for (u32 i = 0; i < empty; i++) {
+				expt += 0.9 * best[i * 2 + 0];
+				expt += 0.1 * best[i * 2 + 1];
+			}
+			expt = lookup.store(expt / empty);
+			return expt;
+		}
+
+		static inline numeric bound_best(const board& before, u32 depth, numeric lo, numeric hi, i32& cut, clip<feature> range, numeric prob = 1) {
+			numeric best = 0, ceil = 0, expt, esti;
+			board moves[4];
+			if (expired(depth)) return cut = 0, 0;
+			for (u32 i = 0, num = expand(before, moves, depth, range); i < num; i++) {
+				const board& after = moves[i];
+				expt = bound_expt(after, depth - 1, std::max(lo, best) - 1 - after.info(), hi - 1 - after.info(), cut, range, prob);
+				esti = after.info() + std::max(expt, numeric(0)) + 1;
+				if (cut < 0 && expt > 0) { ceil = std::max(ceil, esti); continue; } // this move is no better than esti
+				best = std::max(best, esti); // a cut below 0 is still exact, since the value is clamped to 0
+				if (cut > 0 || best >= hi) return cut = 1, best;
+			}
+			cut = (ceil > best) ? -1 : 0; // exact only if no cut move may exceed best
+			return std::max(best, ceil);
+		}
+
+		static inline void estimates(const board* after, numeric* esti, u32 num, clip<feature> range = feature::feats()) {
+			searches(after, esti, num, depth(), range);
+		}
+		static inline void searches(const board* after, numeric* esti, u32 num, u32 depth, clip<feature> range = feature::feats()) {
+			numeric best = -std::numeric_limits<numeric>::max();
+			for (u32 i = 0; i < num; i++) {
+				cache::aging();
+				if (!prune()) {
+					esti[i] = split() > 1 ? search_split(after[i], depth - 1, range) : search_expt(after[i], depth - 1, range);
+					continue;
+				}
+				i32 cut = 0;
+				numeric lo = best - after[i].info();
+				esti[i] = bound_expt(after[i], depth - 1, lo, std::numeric_limits<numeric>::infinity(), cut, range);
+				if (cut) esti[i] = std::min(esti[i], lo); // no better than the best so far
+				else best = std::max(best, after[i].info() + esti[i]);
+			}
+		}
+
+		/**
+		 * time-controlled search by iterative deepening, which returns the results of the deepest finished iteration
+		 * an iteration is not started if the previous one took longer than the remaining time, otherwise it is aborted
+		 * when the budget expires; results of deeper iterations benefit from the TT entries left by shallower ones
+		 */
+		static inline void deepen(const board* after, numeric* esti, u32 num, clip<feature> range = feature::feats()) {
+			if (!num) return;
+			u64 start = moporgic::microsec(), span = budget() * 1000, last = 0;
+			numeric temp[num];
+			u32 reach = 1, most = 1;
+			for (u32 i = 0; i < num; i++) esti[i] = source::estimate(after[i], range);
+			for (u32 i = 0; i < num; i++) most = std::max(most, std::min(depth(), limit(after[i].numof(0)) + 1));
+			deadline() = start + span;
+			for (u32 n = 3; n <= most; n += 2) {
+				u64 tick = moporgic::microsec();
+				if (tick - start + last > span) break;
+				searches(after, temp, num, n, range);
+				if (expired()) break;
+				std::copy_n(temp, num, esti);
+				reach = n;
+				last = moporgic::microsec() - tick;
+			}
+			deadline() = 0;
+			method::reach::local().record((reach + 1) / 2, moporgic::microsec() - start);
+		}
+
 		static inline numeric estimate(const board& after, clip<feature> range = feature::feats()) {
+			cache::aging();
+			if (split() > 1) return search_split(after, depth() - 1, range);
 			return search_expt(after, depth() - 1, range);
 		}
 		static inline numeric optimize(const board& state, numeric updv, clip<feature> range = feature::feats()) {
@@ -1670,6 +2986,17 @@ struct method {
 		static inline u32& depth(u32 n) { return (expectimax<source>::depth() = n); }
 		static inline std::array<u32, 17>& limit() { static std::array<u32, 17> limit = {}; return limit; }
 		static inline u32& limit(u32 e) { return limit()[e]; }
+		static inline u32& split() { static u32 split = 1; return split; }
+		static inline bool& prune() { static bool prune = false; return prune; }
+		static inline numeric& upper() { static numeric upper = 0; return upper; }
+		static inline numeric& cutoff() { static numeric cutoff = 0; return cutoff; }
+		static inline u32& budget() { static u32 budget = 0; return budget; }
+		static inline u64& deadline() { static thread_local u64 deadline = 0; return deadline; } // 0: unlimited; 1: expired
+		static inline bool expired() { return deadline() == 1; }
+		static inline bool expired(u32 depth) { // only check the clock at nodes with enough work below
+			if (deadline() > 1 && depth >= 2 && moporgic::microsec() >= deadline()) deadline() = 1;
+			return expired();
+		}
 	};
 
 	template<typename spec>
@@ -1678,8 +3005,7 @@ struct method {
 		return spec();
 	}
 
-	template<typename mode = weight::segment>
-	static method specialize(utils::options::option opt) {
+	static std::string recognize(utils::options::option opt) {
 		std::string spec = opt["spec"].value("auto");
 		if (spec == "auto") {
 			u32 m = weight::wghts().size();
@@ -1695,11 +3021,18 @@ struct method {
 				std::string list = "4x6patt 5x6patt 6x6patt 7x6patt 8x6patt 2x7patt 3x7patt 1x8patt 2x8patt ";
 				std::string make = opt["make"].value("?"), patt = make.substr(0, make.find_first_of("@&|="));
 				std::string form = format("%ux%upatt", m, n);
+				std::string sign = std::accumulate(weight::wghts().begin(), weight::wghts().end(), std::string{},
+					[](std::string s, weight w) { return s + w.sign() + ' '; });
+#if defined(STATIC_INDEX)
+				list += "custom ";
+#endif
 				if (list.find(patt) != std::string::npos && make.find(' ') == std::string::npos) {
 					spec = patt;
-				} else if (list.find(form) != std::string::npos &&
-					std::accumulate(weight::wghts().begin(), weight::wghts().end(), std::string{},
-						[](std::string s, weight w) { return s + w.sign() + ' '; }) == utils::resolve(form)) {
+#if defined(STATIC_INDEX)
+				} else if (sign == utils::resolve("custom")) {
+					spec = "custom";
+#endif
+				} else if (list.find(form) != std::string::npos && sign == utils::resolve(form)) {
 					spec = form;
 				} else {
 					spec = "isomorphic";
@@ -1708,6 +3041,12 @@ struct method {
 				spec = "common";
 			}
 		}
+		return spec;
+	}
+
+	template<typename mode = weight::segment>
+	static method specialize(utils::options::option opt) {
+		std::string spec = method::recognize(opt);
 		switch (to_hash(spec)) {
 		default: return option<common<mode>>(opt);
 		case to_hash("isomorphic"): return option<isomorphic<mode>>(opt);
@@ -1720,6 +3059,30 @@ struct method {
 		case to_hash("3x7patt"): return option<typename isomorphic<mode>::idx3x7patt>(opt);
 		case to_hash("1x8patt"): return option<typename isomorphic<mode>::idx1x8patt>(opt);
 		case to_hash("2x8patt"): return option<typename isomorphic<mode>::idx2x8patt>(opt);
+#if defined(STATIC_INDEX)
+		case to_hash("custom"):  return option<typename isomorphic<mode>::idxcustom>(opt);
+#endif
+		}
+	}
+
+	template<typename mode = weight::quantum16>
+	static method quantize(utils::options::option opt) {
+		std::string spec = method::recognize(opt);
+		switch (to_hash(spec)) {
+		default: return option<quantized<mode>>(opt);
+		case to_hash("isomorphic"): return option<typename quantized<mode>::isomorphic>(opt);
+		case to_hash("4x6patt"): return option<typename quantized<mode>::template static_index<typename isomorphic<>::idx4x6patt>>(opt);
+		case to_hash("5x6patt"): return option<typename quantized<mode>::template static_index<typename isomorphic<>::idx5x6patt>>(opt);
+		case to_hash("6x6patt"): return option<typename quantized<mode>::template static_index<typename isomorphic<>::idx6x6patt>>(opt);
+		case to_hash("7x6patt"): return option<typename quantized<mode>::template static_index<typename isomorphic<>::idx7x6patt>>(opt);
+		case to_hash("8x6patt"): return option<typename quantized<mode>::template static_index<typename isomorphic<>::idx8x6patt>>(opt);
+		case to_hash("2x7patt"): return option<typename quantized<mode>::template static_index<typename isomorphic<>::idx2x7patt>>(opt);
+		case to_hash("3x7patt"): return option<typename quantized<mode>::template static_index<typename isomorphic<>::idx3x7patt>>(opt);
+		case to_hash("1x8patt"): return option<typename quantized<mode>::template static_index<typename isomorphic<>::idx1x8patt>>(opt);
+		case to_hash("2x8patt"): return option<typename quantized<mode>::template static_index<typename isomorphic<>::idx2x8patt>>(opt);
+#if defined(STATIC_INDEX)
+		case to_hash("custom"):  return option<typename quantized<mode>::template static_index<typename isomorphic<>::idxcustom>>(opt);
+#endif
 		}
 	}
 
@@ -1728,6 +3091,9 @@ struct method {
 		default:
 		case weight::structure::code: return method::specialize<weight::structure>(opt);
 		case weight::coherence::code: return method::specialize<weight::coherence>(opt);
+		case weight::compact::code: return method::specialize<weight::compact>(opt);
+		case weight::quantum16::code: return method::quantize<weight::quantum16>(opt);
+		case weight::quantum8::code: return method::quantize<weight::quantum8>(opt);
 		}
 	}
 
@@ -1786,6 +3152,44 @@ struct select {
 		best = std::max_element(move, move + 4);
 		return *this;
 	}
+	inline select& operator ()(const board& b, clip<feature> range, method spec) {
+		if (!spec.estis) return operator ()(b, range, spec.estim);
+		// estimate all legal afterstates as a single batch
+		b.moves(move[0], move[1], move[2], move[3]);
+		board after[4];
+		numeric esti[4];
+		u32 num = 0;
+		for (state& s : move) if (s.info() != -1u) after[num++] = s;
+		spec.estis(after, esti, num, range);
+		for (u32 i = 0, k = 0; i < 4; i++)
+			move[i].esti = move[i].info() != -1u ? move[i].score() + esti[k++] : -std::numeric_limits<numeric>::max();
+		best = std::max_element(move, move + 4);
+		return *this;
+	}
+	/**
+	 * select for num boards (e.g., of games played in lockstep), where all the legal afterstates are estimated as
+	 * a single batch, so that the weight accesses of independent boards overlap
+	 */
+	static inline void batch(select* sel, const board* b, u32 num, clip<feature> range, method spec) {
+		if (!spec.estis) {
+			for (u32 i = 0; i < num; i++) sel[i](b[i], range, spec);
+			return;
+		}
+		board after[num << 2];
+		numeric esti[num << 2];
+		u32 n = 0;
+		for (u32 i = 0; i < num; i++) {
+			b[i].moves(sel[i].move[0], sel[i].move[1], sel[i].move[2], sel[i].move[3]);
+			for (state& s : sel[i].move) if (s.info() != -1u) after[n++] = s;
+		}
+		spec.estis(after, esti, n, range);
+		for (u32 i = 0, k = 0; i < num; i++) {
+			for (state& s : sel[i].move)
+				s.esti = s.info() != -1u ? s.score() + esti[k++] : -std::numeric_limits<numeric>::max();
+			sel[i].best = std::max_element(sel[i].move, sel[i].move + 4);
+		}
+	}
+
 	inline select& operator <<(const board& b) { return operator ()(b); }
 	inline const select& operator >>(std::vector<state>& path) const { path.push_back(*best); return *this; }
 	inline const select& operator >>(state& s) const { s = *best; return *this; }
@@ -1844,7 +3248,12 @@ struct statistic {
 		}
 	} accum;
 
-	statistic() : info{}, total{}, local{}, accum{} {}
+	cache::stats cached;
+	method::reach reached;
+	method::nodes expanded;
+	method::delta::counter written;
+
+	statistic() : info{}, total{}, local{}, accum{}, cached{}, reached{}, expanded{}, written{} {}
 	statistic(const statistic&) = default;
 
 	bool init(utils::options::option opt = {}) {
@@ -1862,6 +3271,10 @@ struct statistic {
 		total = {};
 		local = {};
 		accum = {};
+		cached = cache::stats::local() = {};
+		reached = method::reach::local() = {};
+		expanded = method::nodes::local() = {};
+		written = method::delta::counter::local() = {};
 		for (u32 i = 0; i < info.thdid; i++) moporgic::srand(moporgic::rand());
 		local.time = moporgic::millisec();
 		info.loop = 1;
@@ -1896,6 +3309,7 @@ struct statistic {
 		local.opers += opers;
 		local.win += (scale >= info.win ? 1 : 0);
 		local.max = std::max(local.max, score);
+		if (method::delta::size()) method::delta::flush();
 		accum.count[math::log2(scale)] += 1;
 		accum.score[math::log2(scale)] += score;
 		accum.opers[math::log2(scale)] += opers;
@@ -1905,6 +3319,11 @@ struct statistic {
 		u64 tick = moporgic::millisec();
 		local.time = tick - local.time;
 		total += local;
+		if (info.thdid == 0) utils::checkpoint::invoke(info.loop / info.unit);
+		if (cache::instance().size() > 1) cached = cache::stats::local(); // only if a TT is in use
+		reached = method::reach::local();
+		expanded = method::nodes::local();
+		written = method::delta::counter::local();
 
 		char buf[256];
 		u32 size = 0;
@@ -1938,7 +3357,7 @@ struct statistic {
 
 	void summary() const {
 		if (info.limit == 0) return;
-		char buf[1024];
+		char buf[4096];
 		size_t size = 0;
 
 		size += snprintf(buf + size, sizeof(buf) - size, summaf, // "summary %llums %.2fops",
@@ -1968,6 +3387,113 @@ struct statistic {
 					remain * 100.0 / total);
 			buf[size++] = '\n';
 		}
+		if (std::accumulate(cached.probe.begin(), cached.probe.end(), u64(0))) {
+			size += snprintf(buf + size, sizeof(buf) - size,
+					"%-6s"  "%12s"    "%9s"   "%12s"    "%9s"     "%9s",
+					"depth", "probe", "hit", "store", "update", "evict");
+			buf[size++] = '\n';
+			for (u32 i = 0; i < cached.probe.size(); i++) {
+				if (cached.probe[i] == 0) continue;
+				u64 store = std::max(cached.store[i], u64(1));
+				size += snprintf(buf + size, sizeof(buf) - size,
+						"%-6u" "%12" PRIu64 "%8.2f%%" "%12" PRIu64 "%8.2f%%" "%8.2f%%",
+						i,
+						cached.probe[i],
+						cached.hit[i] * 100.0 / cached.probe[i],
+						cached.store[i],
+						cached.update[i] * 100.0 / store,
+						cached.evict[i] * 100.0 / store);
+				buf[size++] = '\n';
+			}
+		}
+		if (std::accumulate(expanded.expand.begin(), expanded.expand.end(), u64(0))) {
+			size += snprintf(buf + size, sizeof(buf) - size,
+					"%-6s"  "%12s"     "%12s"    "%9s",
+					"depth", "expand", "dedup", "saved");
+			buf[size++] = '\n';
+			for (u32 i = 0; i < expanded.expand.size(); i++) {
+				if (expanded.expand[i] + expanded.dedup[i] == 0) continue;
+				size += snprintf(buf + size, sizeof(buf) - size,
+						"%-6u" "%12" PRIu64 "%12" PRIu64 "%8.2f%%",
+						i,
+						expanded.expand[i],
+						expanded.dedup[i],
+						expanded.dedup[i] * 100.0 / (expanded.expand[i] + expanded.dedup[i]));
+				buf[size++] = '\n';
+			}
+		}
+		if (u64 moves = std::accumulate(reached.moves.begin(), reached.moves.end(), u64(0))) {
+			size += snprintf(buf + size, sizeof(buf) - size,
+					"%-6s"  "%12s"    "%9s"    "%12s"   "%12s",
+					"reach", "move", "rate", "avg(ms)", "max(ms)");
+			buf[size++] = '\n';
+			for (u32 i = 0; i < reached.moves.size(); i++) {
+				if (reached.moves[i] == 0) continue;
+				size += snprintf(buf + size, sizeof(buf) - size,
+						"%-6s" "%12" PRIu64 "%8.2f%%" "%12.3f" "%12.3f",
+						(std::to_string(i) + 'p').c_str(),
+						reached.moves[i],
+						reached.moves[i] * 100.0 / moves,
+						reached.time[i] * 0.001 / reached.moves[i],
+						reached.peak[i] * 0.001);
+				buf[size++] = '\n';
+			}
+		}
+		if (std::accumulate(written.update.begin(), written.update.end(), u64(0))) {
+			size += snprintf(buf + size, sizeof(buf) - size,
+					"%-10s"  "%12s"     "%9s"     "%12s"    "%9s",
+					"table", "update", "merge", "write", "retry");
+			buf[size++] = '\n';
+			for (u32 i = 0; i < written.update.size(); i++) {
+				if (written.update[i] == 0) continue;
+				size += snprintf(buf + size, sizeof(buf) - size,
+						"%-10s" "%12" PRIu64 "%8.2f%%" "%12" PRIu64 "%8.4f%%",
+						(i < weight::wghts().size() ? weight::wghts()[i].sign() : std::string("?")).c_str(),
+						written.update[i],
+						written.merge[i] * 100.0 / written.update[i],
+						written.write[i],
+						written.retry[i] * 100.0 / std::max(written.write[i], u64(1)));
+				buf[size++] = '\n';
+			}
+		}
+		buf[size++] = '\n';
+		buf[size++] = '\0';
+
+		std::cout << buf << std::flush;
+	}
+
+	/**
+	 * compare evaluations under different weight schemes (e.g., quantized networks) against the first one
+	 */
+	static void compare(const std::vector<std::pair<std::string, statistic>>& evals) {
+		if (std::all_of(evals.begin(), evals.end(), [&](auto& eval) { return eval.first == evals.front().first; })) return;
+		char buf[4096];
+		size_t size = 0;
+
+		auto rate = [](const statistic& stat) -> double { // the 32768 rate
+			u64 count = std::accumulate(stat.accum.count.begin(), stat.accum.count.end(), u64(0));
+			return std::accumulate(stat.accum.count.begin() + 15, stat.accum.count.end(), u64(0)) * 100.0 / count;
+		};
+		auto speed = [](const statistic& stat) -> double {
+			return stat.total.opers * 1000.0 * stat.info.thdnum / stat.total.time;
+		};
+		const statistic& base = evals.front().second;
+		size += snprintf(buf + size, sizeof(buf) - size,
+				"%-8s"   "%8s"   "%9s"    "%9s"    "%14s"  "%9s",
+				"scheme", "avg", "score", "32768", "ops", "speed");
+		buf[size++] = '\n';
+		for (auto& eval : evals) {
+			const statistic& stat = eval.second;
+			size += snprintf(buf + size, sizeof(buf) - size,
+					"%-8s" "%8" PRIu64 "%8.2f%%" "%8.2f%%" "%14.2f" "%8.2fx",
+					eval.first.c_str(),
+					stat.total.score / stat.info.limit,
+					stat.total.score * 100.0 / stat.info.limit / std::max(base.total.score / double(base.info.limit), 1.0),
+					rate(stat),
+					speed(stat),
+					speed(stat) / speed(base));
+			buf[size++] = '\n';
+		}
 		buf[size++] = '\n';
 		buf[size++] = '\0';
 
@@ -1985,6 +3511,10 @@ struct statistic {
 		total += stat.total;
 		local += stat.local;
 		accum += stat.accum;
+		cached += stat.cached;
+		reached += stat.reached;
+		expanded += stat.expanded;
+		written += stat.written;
 		u32 dec = (std::string(summaf).find('%') - std::string(summaf).find('y') + 5) / 2;
 		format(dec, (info.thdnum > 1) ? (" (" + std::to_string(info.thdnum) + "x)") : "");
 		return *this;
@@ -2005,6 +3535,10 @@ statistic run(utils::options::option opt) {
 
 	u32 block = opt["block"].value(2048), limit = opt["limit"].value(65536);
 	list<utils::stage> stage = utils::stage::parse(opt["stage"].value("0"));
+	method::delta::size() = 0;
+	if (opt("delta") && weight::type() == weight::structure::code)
+		spec.optim = method::delta::enable(opt["delta"].value(4096), spec.locate);
+	weight::coherence::atomic() = opt("atomic");
 
 	switch (to_hash(opt["mode"])) {
 	case to_hash("optimize"):
@@ -2058,6 +3592,170 @@ statistic run(utils::options::option opt) {
 		}
 		}(); break;
 
+	case to_hash("optimize:sync"):
+	case to_hash("optimize:sync-forward"): [&]() {
+		// deterministic parallel TD(0): games of a batch are played with the same weights by all workers, where
+		// each game draws from its own random stream keyed by the seed and its index, and then their updates are
+		// applied in the game order, so a seed gives identical networks regardless of the number of threads
+		// the TD targets are fixed when playing, but the errors are taken when applying, so that the updates
+		// of a batch to the same weight do not overshoot
+		u32 thdnum = opt["thread"].value(1), batch = std::max(u32(opt["batch"].value(16)), 1u);
+		utils::options::option conf = opt;
+		conf["thread"] = numeric(1);
+		u64 key = moporgic::rand64();
+		std::vector<std::vector<state>> grad(batch); // afterstates with their targets (as esti) of each game
+		std::vector<statistic::stat> res(batch);
+		moporgic::pool pool(thdnum - 1);
+		for (stats.init(conf); stats; ) {
+			u64 base = stats.info.loop - 1;
+			u32 num = std::min<u64>(batch, stats.info.limit - base);
+			pool.run(num, [&](size_t i) {
+				std::mt19937 engine(math::fmix64(key + (base + i) * 0x9e3779b97f4a7c15ull));
+				moporgic::random::engine_tls() = &engine;
+				std::vector<state>& upd = grad[i];
+				select best;
+				state b, a;
+				u32 score = 0;
+				u32 opers = 0;
+
+				upd.clear();
+				b.init();
+				best(b, feats, spec);
+				score += best.score();
+				opers += 1;
+				best >> a >> b;
+				b.next();
+				while (best(b, feats, spec)) {
+					upd.emplace_back(a, best.esti());
+					score += best.score();
+					opers += 1;
+					best >> a >> b;
+					b.next();
+				}
+				upd.emplace_back(a, 0);
+
+				res[i] = { score, b.scale(), opers };
+				moporgic::random::engine_tls() = nullptr;
+			});
+			for (u32 i = 0; i < num; i++, stats++) {
+				for (state& u : grad[i]) u.instruct(u.esti, alpha, feats, spec);
+				stats.update(res[i]);
+			}
+		}
+		}(); break;
+
+	case to_hash("optimize:replay"): [&]() {
+		// decoupled actors and learners: actors play episodes with the current weights (read only), and publish their
+		// afterstates with the TD(0) targets into a ring; every learner replays all episodes in order, but each only
+		// updates the tables it owns, so that no table is written by multiple threads
+		u32 thdnum = opt["thread"].value(1);
+		u32 learners = std::max(std::min(u32(opt["learner"].value(1)), thdnum - 1), 1u);
+		u32 actors = std::max(thdnum - learners, 1u);
+		struct episode { std::vector<state> path; statistic::stat res; };
+		moporgic::ring<episode> ring(std::max(u32(opt["buffer"].value(2 * actors)), 1u), learners);
+		utils::options::option conf = opt;
+		conf["thread"] = numeric(1);
+		conf["spec"] = std::string("common"); // learners update partial networks
+		method::optimizer optim = method::parse(conf).optim;
+		std::vector<std::vector<feature>> owns(learners);
+		for (feature f : feats) owns[(weight::wghts().find(f.value().sign()) - weight::wghts().begin()) % learners].push_back(f);
+		stats.init(conf);
+		u64 limit = stats.info.limit;
+
+		auto actor = [&](u64 seed) {
+			std::mt19937 engine(seed);
+			moporgic::random::engine_tls() = &engine;
+			select best;
+			for (u64 t; (t = ring.claim()) < limit; ring.publish(t)) {
+				episode& ep = ring.acquire(t);
+				state b, a;
+				u32 score = 0;
+				u32 opers = 0;
+
+				ep.path.clear();
+				b.init();
+				best(b, feats, spec);
+				score += best.score();
+				opers += 1;
+				best >> a >> b;
+				b.next();
+				while (best(b, feats, spec)) {
+					ep.path.emplace_back(a, best.esti());
+					score += best.score();
+					opers += 1;
+					best >> a >> b;
+					b.next();
+				}
+				ep.path.emplace_back(a, 0);
+				ep.res = { score, b.scale(), opers };
+			}
+		};
+		auto learner = [&](u32 id) {
+			clip<feature> own = { owns[id].data(), owns[id].data() + owns[id].size() };
+			for (; ring.next(id) < limit; ring.pop(id)) {
+				const episode& ep = ring.peek(id);
+				for (const state& u : ep.path)
+					optim(u, (u.esti - spec.estim(u, feats)) * alpha, own);
+				if (id == 0) stats.update(ep.res), stats++;
+			}
+		};
+
+		std::list<std::thread> thds;
+		for (u32 i = 0; i < actors; i++) thds.emplace_back(actor, moporgic::rand64());
+		for (u32 i = 1; i < learners; i++) thds.emplace_back(learner, i);
+		learner(0);
+		for (std::thread& thd : thds) thd.join();
+		}(); break;
+
+	case to_hash("optimize:lockstep"):
+	case to_hash("evaluate:lockstep"): [&]() {
+		// interleave a batch of games, where the moves of all games are estimated as a single batch (see select::batch)
+		// unless a search is used, and a finished game is replaced by a new one until the limit is reached; in training,
+		// each game updates its last afterstate in the order of the batch, i.e., the same as forward TD(0)
+		// note that move generation and tile spawning are still per board, so this only overlaps the weight accesses
+		bool learn = to_hash(opt["mode"]) == to_hash("optimize:lockstep");
+		u32 batch = opt["batch"].value(2);
+		bool joint = opt["search"].value(1) <= 1; // a search bounds and times the afterstates of one board together
+		std::vector<select> sel(batch);
+		std::vector<board> b(batch);
+		std::vector<state> a(batch);
+		std::vector<statistic::stat> res(batch);
+		std::vector<u32> over;
+		stats.init(opt);
+		u64 left = stats.info.limit;
+		u32 live = 0;
+		for (; live < batch && left; live++, left--) b[live].init(), res[live] = {};
+		while (live) {
+			if (joint) select::batch(sel.data(), b.data(), live, feats, spec);
+			else for (u32 i = 0; i < live; i++) sel[i](b[i], feats, spec);
+			for (u32 i = 0; i < live; i++) {
+				if (sel[i]) {
+					if (learn && res[i].opers) a[i].optimize(sel[i].esti(), alpha, feats, spec);
+					res[i].score += sel[i].score();
+					res[i].opers += 1;
+					sel[i] >> a[i] >> b[i];
+					b[i].next();
+					continue;
+				}
+				if (learn) a[i].optimize(0, alpha, feats, spec);
+				stats.update(res[i].score, b[i].scale(), res[i].opers);
+				stats++;
+				if (left) { // start a new game in the same slot
+					left--;
+					b[i].init();
+					res[i] = {};
+				} else {
+					over.push_back(i);
+				}
+			}
+			for (; over.size(); over.pop_back()) { // move the last games into the finished slots
+				u32 i = over.back();
+				live--;
+				b[i] = b[live], a[i] = a[live], res[i] = res[live];
+			}
+		}
+		}(); break;
+
 	case to_hash("optimize:backward"): [&]() {
 		for (stats.init(opt); stats; stats++) {
 			board b;
@@ -2542,11 +4240,17 @@ utils::options parse(int argc, const char* argv[]) {
 		case to_hash("-c"): case to_hash("--cache"):
 			opts["cache"] = next_opts("2048M");
 			break;
+		case to_hash("-k"): case to_hash("--checkpoint"):
+			opts["checkpoint"] = next_opts("10");
+			break;
 		case to_hash("-p"): case to_hash("--parallel"): case to_hash("--thread"):
 			opts["thread"] = std::thread::hardware_concurrency();
 			if ((opts[""] = next_opts()).value(0)) opts["thread"].clear();
 			opts["thread"] += opts[""];
 			break;
+		case to_hash("-m"): case to_hash("--memory"):
+			opts["memory"] = next_opts("huge");
+			break;
 		case to_hash("-x"): case to_hash("--options"):
 			opts["options"] += next_opts();
 			break;
@@ -2613,9 +4317,14 @@ utils::options parse(int argc, const char* argv[]) {
 		// set other options (invisible in the display)
 		for (std::string item : {"alpha", "lambda", "step", "stage", "block", "shift", "limit", "thread", "make", "search"})
 			if (opts(item)) opts[recipe][item] << opts[item];
+		if (optimize && opts("checkpoint")) opts[recipe]["checkpoint"] << opts["checkpoint"];
 		for (utils::options::opinion item : opts["options"])
 			opts[recipe][item.label()] << item.value();
 		if (opts("alpha", "norm")) opts[recipe]["norm"] << opts["alpha"]["norm"];
+		if (mode.find(":lockstep") != std::string::npos && !opts[recipe]["batch"].value(1)) {
+			std::cerr << "invalid batch for " << mode << ": " << opts[recipe]["batch"].value() << std::endl;
+			std::exit(1);
+		}
 		// set the final mode and the display
 		opts[recipe]["mode"] = mode;
 		opts[recipe]["what"] = what;
@@ -2642,19 +4351,25 @@ int main(int argc, const char* argv[]) {
 	std::cout << std::endl;
 
 	utils::config_random(opts["seed"]);
-	utils::config_memory(opts["thread"]);
+	utils::config_memory(utils::options::option(opts["thread"]) += opts["memory"]);
 	utils::config_weight(opts["alpha"]);
 
 	utils::init_cache(opts["cache"]);
 	utils::load_network(opts["load"]);
 	utils::make_network(opts["make"]);
 	utils::list_network();
+	if (opts["memory"].size()) utils::list_memory();
 
+	std::vector<std::pair<std::string, statistic>> evals;
 	for (std::string recipe : opts["recipes"]) {
 		std::cout << opts[recipe]["what"] << std::endl << std::endl;
+		utils::checkpoint::config(opts[recipe].find("checkpoint"), opts["save"]);
 		statistic stat = utils::invoke(run, opts[recipe]);
+		utils::checkpoint::finish();
 		if (opts[recipe]("info")) stat.summary();
+		if (recipe.find("evaluate") == 0 && stat.info.limit) evals.emplace_back(weight::scheme(), stat);
 	}
+	statistic::compare(evals);
 
 	utils::save_network(opts["save"]);
 
@@ -404,6 +404,15 @@ public:
 	inline constexpr void isoms(btype iso[]) const { isoms64(iso); }
 	template<typename btype, typename = enable_if_is_base_of<board, btype>>
 	inline constexpr void isoms64(btype iso[]) const {
+#if defined(__AVX2__) && !defined(PREFER_LEGACY_ISOMS) && defined(__cpp_lib_is_constant_evaluated)
+		if (!std::is_constant_evaluated()) {
+			btype x[8];
+			isochain64(x);
+			iso[0] = x[0]; iso[4] = x[1]; iso[1] = x[2]; iso[7] = x[3];
+			iso[2] = x[4]; iso[6] = x[5]; iso[3] = x[6]; iso[5] = x[7];
+			return;
+		}
+#endif
 		iso[5] = *this;       iso[0] = iso[5];
 		iso[5].flip64();      iso[4] = iso[5];
 		iso[5].transpose64(); iso[1] = iso[5];
@@ -425,6 +434,63 @@ public:
 		iso[5].flip80();
 	}
 
+	/**
+	 * the 8 isomorphisms in the order of alternately applying flip and transpose, i.e.,
+	 * x, Fx, TFx, FTFx, TFTFx, ..., which equal x, Fx, TFx, TMFx, MFx, Mx, TMx, Tx
+	 */
+	template<typename btype, typename = enable_if_is_base_of<board, btype>>
+	inline constexpr void isochain(btype iso[]) const { isochain64(iso); }
+	template<typename btype, typename = enable_if_is_base_of<board, btype>>
+	inline constexpr void isochain64(btype iso[]) const {
+		u64 x[8] = {};
+		isochain64(x);
+		for (u32 i = 0; i < 8; i++) (iso[i] = *this).raw = x[i];
+	}
+	inline constexpr void isochain64(u64 iso[]) const {
+#if defined(__AVX2__) && !defined(PREFER_LEGACY_ISOMS) && defined(__cpp_lib_is_constant_evaluated)
+		if (!std::is_constant_evaluated()) {
+			__m256i a, b;
+			isoms64(a, b);
+			alignas(32) u64 u[4], v[4];
+			_mm256_store_si256(reinterpret_cast<__m256i*>(u), a);
+			_mm256_store_si256(reinterpret_cast<__m256i*>(v), b);
+			iso[0] = u[0]; iso[1] = u[1]; iso[2] = v[1]; iso[3] = v[3];
+			iso[4] = u[3]; iso[5] = u[2]; iso[6] = v[2]; iso[7] = v[0];
+			return;
+		}
+#endif
+		board x = raw;
+		iso[0] = x;
+		x.flip64();      iso[1] = x;
+		x.transpose64(); iso[2] = x;
+		x.flip64();      iso[3] = x;
+		x.transpose64(); iso[4] = x;
+		x.flip64();      iso[5] = x;
+		x.transpose64(); iso[6] = x;
+		x.flip64();      iso[7] = x;
+	}
+#if defined(__AVX2__)
+	/**
+	 * compute all 8 isomorphisms in parallel lanes, where a = {x, Fx, Mx, MFx} and b = {Tx, TFx, TMx, TMFx}
+	 */
+	inline void isoms64(__m256i& a, __m256i& b) const {
+		__m256i t;
+		// flip (reverse rows) and mirror (reverse columns) by byte shuffles, then swap nibbles for mirrors
+		a = _mm256_shuffle_epi8(_mm256_set1_epi64x(raw), _mm256_setr_epi8(
+				0, 1, 2, 3, 4, 5, 6, 7, 6, 7, 4, 5, 2, 3, 0, 1,
+				1, 0, 3, 2, 5, 4, 7, 6, 7, 6, 5, 4, 3, 2, 1, 0));
+		t = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi64(a, 4), _mm256_set1_epi8(0x0f)),
+		                    _mm256_and_si256(_mm256_slli_epi64(a, 4), _mm256_set1_epi8(0xf0)));
+		a = _mm256_blend_epi32(a, t, 0b11110000);
+		// transpose all lanes
+		b = a;
+		t = _mm256_and_si256(_mm256_xor_si256(b, _mm256_srli_epi64(b, 12)), _mm256_set1_epi64x(0x0000f0f00000f0f0ull));
+		b = _mm256_xor_si256(b, _mm256_xor_si256(t, _mm256_slli_epi64(t, 12)));
+		t = _mm256_and_si256(_mm256_xor_si256(b, _mm256_srli_epi64(b, 24)), _mm256_set1_epi64x(0x00000000ff00ff00ull));
+		b = _mm256_xor_si256(b, _mm256_xor_si256(t, _mm256_slli_epi64(t, 24)));
+	}
+#endif
+
 	template<typename btype = board, typename = enable_if_is_base_of<board, btype>>
 	inline constexpr std::array<btype, 8> isoms() const { return isoms64(); }
 	template<typename btype = board, typename = enable_if_is_base_of<board, btype>>
@@ -989,6 +1055,21 @@ public:
 	}
 	inline constexpr void isomin() { return isomin64(); }
 	inline constexpr void isomin64() {
+#if defined(__AVX2__) && !defined(PREFER_LEGACY_ISOMS) && defined(__cpp_lib_is_constant_evaluated)
+		if (!std::is_constant_evaluated()) {
+			__m256i a, b, m, s = _mm256_set1_epi64x(0x8000000000000000ull);
+			isoms64(a, b); // unsigned min by signed comparisons
+			a = _mm256_xor_si256(a, s);
+			b = _mm256_xor_si256(b, s);
+			m = _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b));
+			a = _mm256_permute4x64_epi64(m, 0b01001110);
+			m = _mm256_blendv_epi8(m, a, _mm256_cmpgt_epi64(m, a));
+			a = _mm256_shuffle_epi32(m, 0b01001110);
+			m = _mm256_blendv_epi8(m, a, _mm256_cmpgt_epi64(m, a));
+			raw = _mm256_extract_epi64(m, 0) ^ 0x8000000000000000ull;
+			return;
+		}
+#endif
 		u64 x = raw;
 		flip64();      x = std::min(x, raw);
 		transpose64(); x = std::min(x, raw);
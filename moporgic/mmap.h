@@ -0,0 +1,223 @@
+#pragma once
+/*
+ * mmap.h
+ *  Created on: 2026-10-17
+ *      Author: moporgic
+ */
+
+#include <cstdlib>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+#include <cctype>
+#include <initializer_list>
+#include <map>
+#include <set>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#endif
+
+namespace moporgic {
+class mmap {
+#if defined(__linux__) && !defined(NOMMAP)
+public:
+	static constexpr bool support() { return true; }
+	static size_t page() { static size_t page = sysconf(_SC_PAGESIZE); return page; }
+
+	/**
+	 * map size elements of a file starting at offset (must be page-aligned)
+	 * the mapping is private by default, i.e., writes are copy-on-write and never reach the file;
+	 * otherwise, writes go to the file and are visible to all processes sharing the mapping
+	 */
+	template<typename type = void> static type* map(const std::string& path, size_t offset, size_t size, bool write = false, bool shared = false) {
+		if (offset % page()) throw std::invalid_argument("unaligned offset");
+		int fd = open(path.c_str(), write && shared ? O_RDWR : O_RDONLY);
+		if (fd == -1) throw std::bad_alloc();
+		size_t len = size * sizeof(type);
+		void* mem = ::mmap(nullptr, len, PROT_READ | (write ? PROT_WRITE : 0), shared ? MAP_SHARED : MAP_PRIVATE, fd, offset);
+		close(fd);
+		if (mem == MAP_FAILED) throw std::bad_alloc();
+		info().emplace(mem, len);
+		return static_cast<type*>(mem);
+	}
+
+	/**
+	 * allocate size elements from anonymous memory, preferably backed by huge pages, i.e.,
+	 * (1) hugetlb pages of size huge if huge > page(); (2) transparent huge pages if huge != 0; (3) normal pages
+	 * where hugetlb pages are skipped if size is smaller than a page, which would waste most of the page
+	 */
+	template<typename type = void> static type* alloc(size_t size, size_t huge = 0) {
+		size_t len = size * sizeof(type);
+		void* mem = MAP_FAILED;
+		if (huge > page() && len >= huge) {
+			size_t tlb = (len + huge - 1) / huge * huge;
+			int flag = MAP_HUGETLB | (__builtin_ctzll(huge) << MAP_HUGE_SHIFT);
+			mem = ::mmap(nullptr, tlb, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flag, -1, 0);
+			if (mem != MAP_FAILED) len = tlb;
+		}
+		if (mem == MAP_FAILED && huge) {
+			// over-allocate then trim the region to the THP boundaries
+			size_t thp = pmd(), tlen = (len + thp - 1) / thp * thp;
+			void* raw = ::mmap(nullptr, tlen + thp, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			if (raw != MAP_FAILED) {
+				uintptr_t beg = uintptr_t(raw), ptr = (beg + thp - 1) / thp * thp, end = beg + tlen + thp;
+				if (ptr != beg) munmap(raw, ptr - beg);
+				if (end != ptr + tlen) munmap((void*) (ptr + tlen), end - (ptr + tlen));
+				mem = (void*) ptr, len = tlen;
+				madvise(mem, len, MADV_HUGEPAGE);
+			}
+		}
+		if (mem == MAP_FAILED)
+			mem = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mem == MAP_FAILED) throw std::bad_alloc();
+		info().emplace(mem, len);
+		try {
+			new (static_cast<type*>(mem)) type[size]();
+		} catch (...) {}
+		return static_cast<type*>(mem);
+	}
+
+	/**
+	 * reserve size zero-initialized elements from anonymous memory without committing it, i.e.,
+	 * a page is allocated only on its first write, which suits sparse tables that are mostly untouched
+	 */
+	template<typename type = void> static type* reserve(size_t size) {
+		size_t len = size * sizeof(type);
+		void* mem = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (mem == MAP_FAILED) throw std::bad_alloc();
+		madvise(mem, len, MADV_NOHUGEPAGE); // keep the allocation granularity small
+		info().emplace(mem, len);
+		lazy().insert(mem);
+		return static_cast<type*>(mem);
+	}
+
+	template<typename type = void> static void unmap(type* mem) {
+		auto it = info().find((void*) mem);
+		if (it == info().end()) throw std::invalid_argument("not mapped");
+		munmap(it->first, it->second);
+		info().erase(it);
+		lazy().erase((void*) mem);
+	}
+
+	template<typename type = void> static bool mapped(const type* mem) {
+		return info().count((void*) mem);
+	}
+	template<typename type = void> static bool reserved(const type* mem) {
+		return lazy().count((void*) mem);
+	}
+
+	/**
+	 * check whether any page of a memory range is populated (either resident or swapped) from /proc/self/pagemap
+	 * an unpopulated range of anonymous memory has never been written, so it reads as zero
+	 */
+	static bool populated(const void* mem, size_t len) {
+		int fd = open("/proc/self/pagemap", O_RDONLY);
+		if (fd == -1) return true;
+		uintptr_t beg = uintptr_t(mem) / page(), end = (uintptr_t(mem) + len + page() - 1) / page();
+		std::vector<uint64_t> ent(end - beg);
+		ssize_t num = pread(fd, ent.data(), ent.size() * sizeof(uint64_t), beg * sizeof(uint64_t));
+		close(fd);
+		if (num != ssize_t(ent.size() * sizeof(uint64_t))) return true;
+		return std::any_of(ent.begin(), ent.end(), [](uint64_t e) { return e >> 62; }); // bit 63: present, bit 62: swapped
+	}
+
+	/**
+	 * the requested huge page size for type: 0 for none, 1 for THP only, or a hugetlb page size
+	 */
+	template<typename type = void> static size_t huge() { return mmap::hugepage<type>(); }
+	template<typename type = void> static void huge(size_t size) {
+		if (size > 1 && (size & (size - 1))) throw std::invalid_argument("invalid page size");
+		mmap::hugepage<type>() = size;
+	}
+
+	/**
+	 * the PMD size, i.e., the size of a transparent huge page
+	 */
+	static size_t pmd() {
+		static size_t pmd = ({
+			size_t size = 2 << 20;
+			std::ifstream in("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size");
+			in >> size;
+			size;
+		});
+		return pmd;
+	}
+
+	struct usage {
+		size_t page = 0; // the kernel page size
+		size_t size = 0; // the resident size in bytes
+		size_t huge = 0; // the resident size backed by huge pages (either hugetlb or THP)
+	};
+
+	/**
+	 * collect the page usage of the memory regions containing the given addresses from /proc/self/smaps
+	 * each region is counted only once, the page size is the largest among the regions
+	 */
+	static usage status(std::initializer_list<const void*> mem) { return status(mem.begin(), mem.end()); }
+	template<typename iter> static usage status(iter first, iter last) {
+		usage use;
+		std::set<uintptr_t> addr;
+		for (auto it = first; it != last; it++) addr.insert(uintptr_t(*it));
+		std::ifstream in("/proc/self/smaps");
+		bool hit = false;
+		for (std::string line; std::getline(in, line); ) {
+			uintptr_t beg = 0, end = 0;
+			char dash = 0;
+			if (std::isxdigit(line[0]) && (std::stringstream(line) >> std::hex >> beg >> dash >> end) && dash == '-') {
+				auto it = addr.lower_bound(beg);
+				hit = it != addr.end() && *it < end;
+				continue;
+			}
+			if (!hit) continue;
+			std::string key;
+			size_t val = 0;
+			std::stringstream(line) >> key >> val;
+			if (key == "KernelPageSize:") use.page = std::max(use.page, val << 10);
+			if (key == "Rss:" || key == "Private_Hugetlb:" || key == "Shared_Hugetlb:") use.size += val << 10;
+			if (key == "AnonHugePages:" || key == "ShmemPmdMapped:" || key == "Private_Hugetlb:" || key == "Shared_Hugetlb:") use.huge += val << 10;
+		}
+		return use;
+	}
+
+protected:
+	static std::map<void*, size_t>& info() {
+		static std::map<void*, size_t> info;
+		return info;
+	}
+	static std::set<void*>& lazy() {
+		static std::set<void*> lazy;
+		return lazy;
+	}
+	template<typename type = void> static size_t& hugepage() { static size_t huge = 0; return huge; }
+
+#else /* if mmap is not supported */
+public:
+	static constexpr bool support() { return false; }
+	static size_t page() { return 4096; }
+	template<typename type = void> static type* map(const std::string& path, size_t offset, size_t size, bool write = false, bool shared = false) { throw std::bad_alloc(); }
+	template<typename type = void> static void unmap(type* mem) { throw std::bad_alloc(); }
+	template<typename type = void> static bool mapped(const type* mem) { return false; }
+	template<typename type = void> static bool reserved(const type* mem) { return false; }
+	static bool populated(const void* mem, size_t len) { return true; }
+	template<typename type = void> static type* alloc(size_t size, size_t huge = 0) { throw std::bad_alloc(); }
+	template<typename type = void> static type* reserve(size_t size) { throw std::bad_alloc(); }
+	template<typename type = void> static size_t huge() { return 0; }
+	template<typename type = void> static void huge(size_t size) { if (size) throw std::invalid_argument("huge page is not supported"); }
+	static size_t pmd() { return 2 << 20; }
+	struct usage { size_t page = 0, size = 0, huge = 0; };
+	static usage status(std::initializer_list<const void*> mem) { return {}; }
+	template<typename iter> static usage status(iter first, iter last) { return {}; }
+#endif /* end if */
+};
+
+} // namespace moporgic
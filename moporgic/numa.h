@@ -0,0 +1,176 @@
+#pragma once
+/*
+ * numa.h
+ *  Created on: 2026-10-17
+ *      Author: moporgic
+ */
+
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <vector>
+#include <map>
+#include <algorithm>
+#if defined(__linux__)
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+
+namespace moporgic {
+class numa {
+#if defined(__linux__) && !defined(NONUMA)
+public:
+	static constexpr bool support() { return true; }
+
+	/**
+	 * the online nodes that contain at least one CPU allowed by the initial affinity
+	 */
+	static const std::vector<int>& nodes() {
+		static std::vector<int> nodes = ({
+			std::vector<int> nodes;
+			for (auto& node : topology()) nodes.push_back(node.first);
+			nodes;
+		});
+		return nodes;
+	}
+
+	/**
+	 * the allowed CPUs of a node, ordered by physical cores first, then by their SMT siblings
+	 */
+	static const std::vector<int>& cpus(int node) {
+		static const std::vector<int> none;
+		auto it = topology().find(node);
+		return it != topology().end() ? it->second : none;
+	}
+
+	static int node(int cpu) {
+		for (auto& node : topology())
+			if (std::count(node.second.begin(), node.second.end(), cpu)) return node.first;
+		return -1;
+	}
+
+	/**
+	 * place num workers, i.e., return a CPU for each worker
+	 * workers are distributed to nodes in contiguous blocks proportional to the number of CPUs
+	 */
+	static std::vector<int> place(size_t num) {
+		std::vector<int> res;
+		size_t total = 0, accum = 0;
+		for (int node : nodes()) total += cpus(node).size();
+		for (int node : nodes()) {
+			const std::vector<int>& cpu = cpus(node);
+			size_t first = num * accum / total, last = num * (accum += cpu.size()) / total;
+			for (size_t i = first; i < last; i++) res.push_back(cpu[(i - first) % cpu.size()]);
+		}
+		return res;
+	}
+
+	/**
+	 * pin the calling thread (or process) to a CPU
+	 */
+	static bool bind(int cpu) { return affinity({ cpu }); }
+
+	/**
+	 * get or set the CPUs allowed for the calling thread (or process)
+	 */
+	static std::vector<int> affinity() {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		sched_getaffinity(0, sizeof(set), &set);
+		std::vector<int> cpus;
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+			if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+		return cpus;
+	}
+	static bool affinity(const std::vector<int>& cpus) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (int cpu : cpus) CPU_SET(cpu, &set);
+		return sched_setaffinity(0, sizeof(set), &set) == 0;
+	}
+
+	/**
+	 * interleave the pages of [mem, mem + len) over nodes, existing pages are migrated accordingly
+	 */
+	static bool interleave(const void* mem, size_t len, const std::vector<int>& nodes = numa::nodes()) {
+		return policy(mem, len, MPOL_INTERLEAVE, nodes);
+	}
+
+	/**
+	 * place the pages of [mem, mem + len) on a node, existing pages are migrated accordingly
+	 */
+	static bool bind(const void* mem, size_t len, int node) {
+		return policy(mem, len, MPOL_BIND, { node });
+	}
+
+protected:
+	static bool policy(const void* mem, size_t len, int mode, const std::vector<int>& nodes) {
+		if (len == 0 || nodes.empty()) return false;
+		size_t page = sysconf(_SC_PAGESIZE);
+		uintptr_t beg = uintptr_t(mem) / page * page, end = (uintptr_t(mem) + len + page - 1) / page * page;
+		std::vector<unsigned long> mask(*std::max_element(nodes.begin(), nodes.end()) / (8 * sizeof(long)) + 1);
+		for (int node : nodes) mask[node / (8 * sizeof(long))] |= 1ul << (node % (8 * sizeof(long)));
+		return syscall(SYS_mbind, beg, end - beg, mode, mask.data(), mask.size() * 8 * sizeof(long) + 1, MPOL_MF_MOVE) == 0;
+	}
+
+	static std::vector<int> parse(const std::string& res) { // e.g., 0-19,40-59
+		std::vector<int> list;
+		std::stringstream tokens(res);
+		for (std::string token; std::getline(tokens, token, ',');) {
+			int i = -1, n = -1; char x = '.';
+			std::stringstream(token) >> i >> x >> n;
+			if (i != -1) list.push_back(i);
+			if (x == '-' && n != -1) while (++i <= n) list.push_back(i);
+		}
+		return list;
+	}
+	static std::string read(const std::string& path) {
+		std::string res;
+		std::ifstream in(path);
+		std::getline(in, res);
+		return res;
+	}
+
+	static const std::map<int, std::vector<int>>& topology() {
+		static std::map<int, std::vector<int>> topo = ({
+			std::map<int, std::vector<int>> topo;
+			std::vector<int> allow = affinity();
+			for (int node : parse(read("/sys/devices/system/node/online"))) {
+				std::vector<int> cpus;
+				for (int cpu : parse(read("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist")))
+					if (std::count(allow.begin(), allow.end(), cpu)) cpus.push_back(cpu);
+				if (cpus.size()) topo[node] = cpus;
+			}
+			if (topo.empty() && allow.size()) topo[0] = allow; // no topology available, assume a single node
+			std::map<int, size_t> rank; // rank of each CPU among its SMT siblings
+			for (int cpu : allow) {
+				std::vector<int> sibs = parse(read("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/thread_siblings_list"));
+				rank[cpu] = std::find(sibs.begin(), sibs.end(), cpu) - sibs.begin();
+			}
+			for (auto& node : topo)
+				std::stable_sort(node.second.begin(), node.second.end(), [&](int u, int v) { return rank[u] < rank[v]; });
+			topo;
+		});
+		return topo;
+	}
+
+#else /* if numa is not supported */
+public:
+	static constexpr bool support() { return false; }
+	static const std::vector<int>& nodes() { static const std::vector<int> nodes = { 0 }; return nodes; }
+	static const std::vector<int>& cpus(int node) { static const std::vector<int> cpus; return cpus; }
+	static int node(int cpu) { return 0; }
+	static std::vector<int> place(size_t num) { return {}; }
+	static bool bind(int cpu) { return false; }
+	static std::vector<int> affinity() { return {}; }
+	static bool affinity(const std::vector<int>& cpus) { return false; }
+	static bool interleave(const void* mem, size_t len, const std::vector<int>& nodes = numa::nodes()) { return false; }
+	static bool bind(const void* mem, size_t len, int node) { return false; }
+#endif /* end if */
+};
+
+} // namespace moporgic
@@ -0,0 +1,82 @@
+#pragma once
+/*
+ * pack.h
+ *  Created on: 2026-10-17
+ *      Author: moporgic
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace moporgic {
+
+/**
+ * a run-length codec of words for sparse tables
+ * a packed stream is a list of tokens (zeros, literals) followed by the literal words, where both counts are varints;
+ * zero runs shorter than 2 words are kept as literals, and words are compared bitwise (i.e., -0.0f is a literal)
+ */
+namespace pack {
+
+template<typename word> std::string encode(const word* src, size_t num) {
+	std::string out;
+	out.reserve(num * sizeof(word) / 4 + 16);
+	auto put = [&](size_t v) {
+		for (; v >= 0x80; v >>= 7) out.push_back(char(v | 0x80));
+		out.push_back(char(v));
+	};
+	for (size_t i = 0; i < num; ) {
+		size_t z = i, l;
+		while (z < num && src[z] == 0) z++;
+		for (l = z; l < num && (src[l] != 0 || (l + 1 < num && src[l + 1] != 0)); l++);
+		put(z - i);
+		put(l - z);
+		out.append(reinterpret_cast<const char*>(src + z), (l - z) * sizeof(word));
+		i = l;
+	}
+	return out;
+}
+
+/**
+ * encode num zero words, i.e., the same as encode but without reading them
+ */
+inline std::string zeros(size_t num) {
+	std::string out;
+	size_t v = num;
+	for (; v >= 0x80; v >>= 7) out.push_back(char(v | 0x80));
+	out.push_back(char(v));
+	out.push_back(char(0));
+	return out;
+}
+
+/**
+ * decode a packed stream of len bytes into exactly num words, return false if the stream is malformed
+ * zero runs are not written if dst is known to be zero-initialized, so that untouched memory stays uncommitted
+ */
+template<typename word> bool decode(const char* src, size_t len, word* dst, size_t num, bool zeroed = false) {
+	const uint8_t* ptr = reinterpret_cast<const uint8_t*>(src);
+	const uint8_t* end = ptr + len;
+	auto get = [&](size_t& v) -> bool {
+		v = 0;
+		for (uint32_t s = 0; ptr < end && s < 64; s += 7) {
+			v |= size_t(*ptr & 0x7f) << s;
+			if (!(*ptr++ & 0x80)) return true;
+		}
+		return false;
+	};
+	for (size_t i = 0, z, l; ptr < end; i += l) {
+		if (!get(z) || !get(l) || z > num - i) return false;
+		if (!zeroed) std::memset(dst + i, 0, z * sizeof(word));
+		i += z;
+		if (l > num - i || l * sizeof(word) > size_t(end - ptr)) return false;
+		std::memcpy(dst + i, ptr, l * sizeof(word));
+		ptr += l * sizeof(word);
+		if (ptr == end) return i + l == num;
+	}
+	return num == 0;
+}
+
+} // namespace pack
+
+} // namespace moporgic
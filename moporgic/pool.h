@@ -0,0 +1,94 @@
+#pragma once
+/*
+ * pool.h
+ *  Created on: 2026-10-17
+ *      Author: moporgic
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+namespace moporgic {
+
+/**
+ * a pool of helper threads for fork-join parallelism
+ * tasks of a job are claimed dynamically by both the helpers and the caller, and the caller returns when all are done
+ */
+class pool {
+public:
+	pool(size_t num = 0) : next(0), limit(0), gen(0), busy(0), quit(false) { resize(num); }
+	pool(const pool&) = delete;
+	~pool() { resize(0); }
+
+	size_t size() const { return thds.size(); }
+
+	void resize(size_t num) {
+		if (num == thds.size()) return;
+		{ std::lock_guard<std::mutex> lock(mtx); quit = true; }
+		wake.notify_all();
+		for (std::thread& thd : thds) thd.join();
+		thds.clear();
+		std::lock_guard<std::mutex> lock(mtx);
+		quit = false;
+		for (size_t i = 0; i < num; i++) thds.emplace_back(&pool::work, this, gen); // only join jobs run after this
+	}
+
+	/**
+	 * invoke task(i) for i in [0, num), then invoke done() once on every participating thread
+	 */
+	void run(size_t num, std::function<void(size_t)> task, std::function<void()> done = nullptr) {
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			this->task = task;
+			this->done = done;
+			next = 0;
+			limit = num;
+			busy = thds.size();
+			gen++;
+		}
+		wake.notify_all();
+		execute();
+		std::unique_lock<std::mutex> lock(mtx);
+		idle.wait(lock, [this]() { return busy == 0; });
+	}
+
+protected:
+	void execute() {
+		for (size_t i; (i = next++) < limit; ) task(i);
+		if (done) done();
+	}
+
+	void work(uint64_t seen) {
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				wake.wait(lock, [&]() { return quit || gen != seen; });
+				if (quit) return;
+				seen = gen;
+			}
+			execute();
+			std::lock_guard<std::mutex> lock(mtx);
+			if (--busy == 0) idle.notify_all();
+		}
+	}
+
+private:
+	std::vector<std::thread> thds;
+	std::mutex mtx;
+	std::condition_variable wake, idle;
+	std::function<void(size_t)> task;
+	std::function<void()> done;
+	std::atomic<size_t> next;
+	size_t limit;
+	uint64_t gen;
+	size_t busy;
+	bool quit;
+};
+
+} // namespace moporgic
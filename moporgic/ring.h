@@ -0,0 +1,68 @@
+#pragma once
+/*
+ * ring.h
+ *  Created on: 2026-10-17
+ *      Author: moporgic
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include <atomic>
+#include <thread>
+
+namespace moporgic {
+
+/**
+ * a bounded lock-free ring that broadcasts items from multiple writers to a fixed number of readers
+ * writers claim slots in the order of tickets, and a slot is reused only after all readers have passed it,
+ * so every reader sees every item in the ticket order; waiting is done by yielding
+ */
+template<typename item> class ring {
+public:
+	ring(size_t size, size_t readers) : slots(size), ready(size), seen(readers), head(0) {
+		for (cursor& c : ready) c.n = 0;
+		for (cursor& c : seen) c.n = 0;
+	}
+	ring(const ring&) = delete;
+
+	size_t size() const { return slots.size(); }
+
+	/**
+	 * claim a ticket, then wait until its slot is free, i.e., all readers have passed the previous round
+	 */
+	uint64_t claim() { return head.fetch_add(1, std::memory_order_relaxed); }
+	item& acquire(uint64_t t) {
+		while (t >= tail() + size()) std::this_thread::yield();
+		return slots[t % size()];
+	}
+	void publish(uint64_t t) { ready[t % size()].n.store(t + 1, std::memory_order_release); }
+
+	/**
+	 * wait until the next item of reader r is published, and then release it after use
+	 */
+	uint64_t next(size_t r) const { return seen[r].n.load(std::memory_order_relaxed); }
+	const item& peek(size_t r) const {
+		uint64_t t = next(r);
+		while (ready[t % size()].n.load(std::memory_order_acquire) != t + 1) std::this_thread::yield();
+		return slots[t % size()];
+	}
+	void pop(size_t r) { seen[r].n.store(next(r) + 1, std::memory_order_release); }
+
+protected:
+	uint64_t tail() const {
+		uint64_t t = UINT64_MAX;
+		for (const cursor& c : seen) t = std::min(t, c.n.load(std::memory_order_acquire));
+		return t;
+	}
+
+private:
+	struct alignas(64) cursor { std::atomic<uint64_t> n; };
+	std::vector<item> slots;
+	std::vector<cursor> ready;
+	std::vector<cursor> seen;
+	alignas(64) std::atomic<uint64_t> head;
+};
+
+} // namespace moporgic
@@ -10,11 +10,15 @@
 #include <memory>
 #if defined(__linux__)
 #include <sys/shm.h>
+#include <sys/mman.h>
 #include <signal.h>
 #include <string>
 #include <fstream>
 #include <utility>
 #include <map>
+#ifndef SHM_HUGE_SHIFT
+#define SHM_HUGE_SHIFT 26
+#endif
 #endif
 
 namespace moporgic {
@@ -23,7 +27,12 @@ class shm {
 public:
 	static constexpr bool support() { return true; }
 
-	template<typename type = void> static type* alloc(size_t size) {
+	/**
+	 * allocate size elements from a new shm segment, which is backed by
+	 * hugetlb pages if huge > 4K and the segment is not smaller than a page of size huge,
+	 * or by transparent huge pages if huge != 0 (and hugetlb is not available)
+	 */
+	template<typename type = void> static type* alloc(size_t size, size_t huge = 0) {
 		if (!enable<type>()) throw std::invalid_argument("shm is disabled");
 		static uint8_t seq = 0;
 		static std::string hook = ({
@@ -34,12 +43,21 @@ public:
 		});
 		if (++seq == 0) throw std::bad_alloc();
 		auto key = ftok(hook.c_str(), seq);
-		int id = shmget(key, size * sizeof(type), IPC_CREAT | IPC_EXCL | 0600);
+		size_t len = size * sizeof(type);
+		int id = -1;
+		if (huge > 4096 && len >= huge) {
+			size_t tlb = (len + huge - 1) / huge * huge;
+			int flag = SHM_HUGETLB | (__builtin_ctzll(huge) << SHM_HUGE_SHIFT);
+			id = shmget(key, tlb, IPC_CREAT | IPC_EXCL | 0600 | flag);
+		}
+		bool tlb = id != -1;
+		if (!tlb) id = shmget(key, len, IPC_CREAT | IPC_EXCL | 0600);
 		void* shm = shmat(id, nullptr, 0);
 		if (shm == (void*) -1ull) {
-			if (errno & EEXIST) return alloc<type>(size);
+			if (errno & EEXIST) return alloc<type>(size, huge);
 			throw std::bad_alloc();
 		}
+		if (huge && !tlb) madvise(shm, len, MADV_HUGEPAGE);
 		info().emplace(shm, std::make_pair(id, size));
 		try {
 			new (cast<type*>(shm)) type[size]();
@@ -97,7 +115,7 @@ protected:
 #else /* if shm is not supported */
 public:
 	static constexpr bool support() { return false; }
-	template<typename type = void> static type* alloc(size_t size) { throw std::bad_alloc(); }
+	template<typename type = void> static type* alloc(size_t size, size_t huge = 0) { throw std::bad_alloc(); }
 	template<typename type = void> static void free(type* shm) { throw std::bad_alloc(); }
 protected:
 	static void clear() {}
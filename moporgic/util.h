@@ -194,9 +194,12 @@ public:
 	inline operator double() const { return std::uniform_real_distribution<double>(0.0, 1.0)(engine_ref<engine_t>()); }
 
 	template<typename engine_t = std::mt19937>
-	static inline auto& engine_ref() { return *(engine_ptr<engine_t>()); }
+	static inline auto& engine_ref() { return *(engine_tls<engine_t>() ?: engine_ptr<engine_t>()); }
 	template<typename engine_t = std::mt19937>
 	static inline auto& engine_ptr() { static engine_t* engine = nullptr; return engine; }
+	// a thread-local engine that overrides the shared one if set, e.g., for per-worker random streams
+	template<typename engine_t = std::mt19937>
+	static inline auto& engine_tls() { static thread_local engine_t* engine = nullptr; return engine; }
 	template<typename engine_t = std::mt19937>
 	static inline auto next() { return (engine_ref<engine_t>())(); }
 